@@ -40,76 +40,120 @@
 #include "Array.h"
 
 int counter=0;
-double Array::ReadCell(int x, int y, char* mode) {
-    // mode is only for the 3T1C cell to select LSB or MSB
-    // it should be "MSB_LTP","MSB_LTD" or "LSB" 
-	if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(**cell)){ // Analog eNVM
-		double readVoltage = static_cast<eNVM*>(cell[x][y])->readVoltage;
-		double totalWireResistance;
-		if (static_cast<eNVM*>(cell[x][y])->cmosAccess){  // 1T1R cell or 1T1C cell
-			if (static_cast<AnalogNVM*>(cell[x][y])->FeFET) // FeFET
-				totalWireResistance = (x + 1) * wireResistanceRow + (arrayRowSize - y) * wireResistanceCol; // do not need to consider the access resistance
-            else // Normal
-				totalWireResistance = (x + 1) * wireResistanceRow + (arrayRowSize - y) * wireResistanceCol + static_cast<eNVM*>(cell[x][y])->resistanceAccess;
+/* Read path of an analog eNVM cell, instantiated per device type (so that the device read is not a virtual call) and per ReadConfig */
+template <class DeviceT, int config>
+double Array::ReadAnalogCell(int x, int y) {
+	int index = CellIndex(x, y);
+	if (config & READ_CACHED) {	// Conductance only changes on writes, which refresh readCurrent
+		return readCurrent[index];
+	}
+	DeviceT *device = static_cast<DeviceT*>(cell[x][y]);
+	double readVoltage = device->readVoltage;
+	double totalWireResistance = readPathResistance[index];
+	bool nonlinearIV = (config & READ_MIXED)? device->nonlinearIV : (config & READ_NONLINEAR_IV) != 0;
+	bool readNoise = (config & READ_MIXED)? device->readNoise : (config & READ_NOISE) != 0;
+	double cellCurrent;
+	if (nonlinearIV){
+		// Bisection method to calculate read current with nonlinearity
+		int maxIter = 30;
+		double v1 = 0, v2 = readVoltage, v3;
+		double wireCurrent;
+		for (int iter=0; iter<maxIter; iter++){
+			v3 = (v1 + v2)/2;
+			wireCurrent = (readVoltage - v3)/totalWireResistance;
+			cellCurrent = device->DeviceT::Read(v3);
+			if (wireCurrent > cellCurrent)
+				v1 = v3;
+			else
+				v2 = v3;
+		}
+	} 
+    else{	// No nonlinearity
+		if (readNoise){
+			cellCurrent = readVoltage / (1/conductance[index] * (1 + device->ReadRandom().Normal(*device->gaussian_dist)) + totalWireResistance);
 		} 
-        else 
-			totalWireResistance = (x + 1) * wireResistanceRow + (arrayRowSize - y) * wireResistanceCol;
-		double cellCurrent;
-		if (static_cast<eNVM*>(cell[x][y])->nonlinearIV){
-			// Bisection method to calculate read current with nonlinearity
-			int maxIter = 30;
-			double v1 = 0, v2 = readVoltage, v3;
-			double wireCurrent;
-			for (int iter=0; iter<maxIter; iter++){
-				v3 = (v1 + v2)/2;
-				wireCurrent = (readVoltage - v3)/totalWireResistance;
-				cellCurrent = static_cast<AnalogNVM*>(cell[x][y])->Read(v3);
-				if (wireCurrent > cellCurrent)
-					v1 = v3;
-				else
-					v2 = v3;
+        else
+			cellCurrent = readVoltage / (1/conductance[index] + totalWireResistance);
+	}
+	return cellCurrent;
+}
+
+template <class DeviceT>
+Array::ReadKernel Array::ReadKernelOf(int config) {
+	switch (config) {
+		case READ_CACHED:		return &Array::ReadAnalogCell<DeviceT, READ_CACHED>;
+		case 0:					return &Array::ReadAnalogCell<DeviceT, 0>;
+		case READ_NONLINEAR_IV:	return &Array::ReadAnalogCell<DeviceT, READ_NONLINEAR_IV>;
+		case READ_NOISE:		return &Array::ReadAnalogCell<DeviceT, READ_NOISE>;
+		case READ_NONLINEAR_IV | READ_NOISE:	return &Array::ReadAnalogCell<DeviceT, READ_NONLINEAR_IV | READ_NOISE>;
+		default:				return &Array::ReadAnalogCell<DeviceT, READ_MIXED>;
+	}
+}
+
+/* Pick the read kernel of the analog eNVM cells from their read flags (called by UpdateReadPath()) */
+void Array::SelectReadKernel() {
+	readConfig = 0;
+	readAnalogCell = NULL;
+	if (!IsAnalogNVM()) {
+		return;
+	}
+	eNVM *first = static_cast<eNVM*>(cell[0][0]);
+	for (int row=0; row<arrayRowSize; row++) {
+		for (int col=0; col<numCellCols; col++) {
+			eNVM *envm = static_cast<eNVM*>(cell[col][row]);
+			if (envm->nonlinearIV != first->nonlinearIV || envm->readNoise != first->readNoise) {
+				readConfig = READ_MIXED;
 			}
-		} 
-        else{	// No nonlinearity
-			if (static_cast<eNVM*>(cell[x][y])->readNoise){
-				extern std::mt19937 gen;
-				cellCurrent = readVoltage / (1/static_cast<eNVM*>(cell[x][y])->conductance * (1 + (*static_cast<eNVM*>(cell[x][y])->gaussian_dist)(gen)) + totalWireResistance);
-			} 
-            else
-				cellCurrent = readVoltage / (1/static_cast<eNVM*>(cell[x][y])->conductance + totalWireResistance);
 		}
-		return cellCurrent;
+	}
+	if (readConfig != READ_MIXED) {
+		if (cachedReadCurrent) {
+			readConfig = READ_CACHED;
+		} else {
+			readConfig = (first->nonlinearIV? READ_NONLINEAR_IV : 0) | (first->readNoise? READ_NOISE : 0);
+		}
+	}
+	switch (deviceType) {
+		case REAL_DEVICE:		readAnalogCell = ReadKernelOf<RealDevice>(readConfig); break;
+		case IDEAL_DEVICE:		readAnalogCell = ReadKernelOf<IdealDevice>(readConfig); break;
+		case MEASURED_DEVICE:	readAnalogCell = ReadKernelOf<MeasuredDevice>(readConfig); break;
+		default:				readAnalogCell = ReadKernelOf<_2T1F>(readConfig); break;
+	}
+}
+
+double Array::ReadCell(int x, int y, char* mode) {
+    // mode is only for the 3T1C cell to select LSB or MSB
+    // it should be "MSB_LTP","MSB_LTD" or "LSB" 
+	if (IsAnalogNVM()){ // Analog eNVM
+		return (this->*readAnalogCell)(x, y);
 	} 
-    else if (HybridCell *temp = dynamic_cast<HybridCell*>(**cell)){
+    else if (IsHybridCell()){
         if(mode=="LSB"){
-            extern std::mt19937 gen;
             double readVoltage_LSB =  static_cast<HybridCell*>(cell[x][y])->LSBcell.readVoltage;
             double totalWireResistance_LSB = (x + 1) * wireResistanceRow + (arrayRowSize - y) * wireResistanceCol;
             double cellCurrent_LSB;
             if (static_cast<HybridCell*>(cell[x][y])->LSBcell.readNoise)
-				cellCurrent_LSB = readVoltage_LSB / (1/static_cast<HybridCell*>(cell[x][y])->LSBcell.conductance * (1 + (*static_cast<HybridCell*>(cell[x][y])->LSBcell.gaussian_dist)(gen)) + totalWireResistance_LSB);
+				cellCurrent_LSB = readVoltage_LSB / (1/static_cast<HybridCell*>(cell[x][y])->LSBcell.conductance * (1 + static_cast<HybridCell*>(cell[x][y])->LSBcell.ReadRandom().Normal(*static_cast<HybridCell*>(cell[x][y])->LSBcell.gaussian_dist)) + totalWireResistance_LSB);
             else
                 cellCurrent_LSB = readVoltage_LSB / (1/static_cast<HybridCell*>(cell[x][y])->LSBcell.conductance + totalWireResistance_LSB);      
             return cellCurrent_LSB;
         }
         else if(mode=="MSB_LTP"){
-            extern std::mt19937 gen;
             double readVoltage_MSB = static_cast<HybridCell*>(cell[x][y])->MSBcell_LTP.readVoltage;
             double totalWireResistance_MSB=  (x + 1) * wireResistanceRow + (arrayRowSize - y) * wireResistanceCol +static_cast<HybridCell*>(cell[x][y])->MSBcell_LTP.resistanceAccess;
             double cellCurrent_MSB_LTP;
             if (static_cast<HybridCell*>(cell[x][y])->MSBcell_LTP.readNoise) 
-                cellCurrent_MSB_LTP = readVoltage_MSB / (1/static_cast<HybridCell*>(cell[x][y])->MSBcell_LTP.conductance * (1 + (*static_cast<HybridCell*>(cell[x][y])->MSBcell_LTP.gaussian_dist)(gen)) + totalWireResistance_MSB);
+                cellCurrent_MSB_LTP = readVoltage_MSB / (1/static_cast<HybridCell*>(cell[x][y])->MSBcell_LTP.conductance * (1 + static_cast<HybridCell*>(cell[x][y])->MSBcell_LTP.ReadRandom().Normal(*static_cast<HybridCell*>(cell[x][y])->MSBcell_LTP.gaussian_dist)) + totalWireResistance_MSB);
             else
                 cellCurrent_MSB_LTP = readVoltage_MSB / (1/static_cast<HybridCell*>(cell[x][y])->MSBcell_LTP.conductance +  totalWireResistance_MSB);
            return cellCurrent_MSB_LTP;
         }
         else if(mode=="MSB_LTD"){
-            extern std::mt19937 gen;
             double readVoltage_MSB = static_cast<HybridCell*>(cell[x][y])->MSBcell_LTD.readVoltage;  
             double totalWireResistance_MSB=  (x + 1) * wireResistanceRow + (arrayRowSize - y) * wireResistanceCol +(static_cast<HybridCell*>(cell[x][y])->MSBcell_LTP).resistanceAccess;
             double cellCurrent_MSB_LTD;          
             if (static_cast<HybridCell*>(cell[x][y])->MSBcell_LTD.readNoise) 
-                cellCurrent_MSB_LTD = readVoltage_MSB / (1/static_cast<HybridCell*>(cell[x][y])->MSBcell_LTD.conductance * (1 + (*static_cast<HybridCell*>(cell[x][y])->MSBcell_LTD.gaussian_dist)(gen)) + totalWireResistance_MSB);
+                cellCurrent_MSB_LTD = readVoltage_MSB / (1/static_cast<HybridCell*>(cell[x][y])->MSBcell_LTD.conductance * (1 + static_cast<HybridCell*>(cell[x][y])->MSBcell_LTD.ReadRandom().Normal(*static_cast<HybridCell*>(cell[x][y])->MSBcell_LTD.gaussian_dist)) + totalWireResistance_MSB);
             else
                 cellCurrent_MSB_LTD = readVoltage_MSB / (1/static_cast<HybridCell*>(cell[x][y])->MSBcell_LTD.conductance + totalWireResistance_MSB); 
             return cellCurrent_MSB_LTD;  
@@ -118,17 +162,17 @@ double Array::ReadCell(int x, int y, char* mode) {
     }
     else{ // SRAM or digital eNVM
 		int weightDigits = 0;
-		if (DigitalNVM *temp = dynamic_cast<DigitalNVM*>(**cell)) {	// Digital eNVM
+		if (IsDigitalNVM()) {	// Digital eNVM
 			for (int n=0; n<numCellPerSynapse; n++){   // n=0 is LSB
 				int colIndex = (x+1) * numCellPerSynapse - (n+1);
 				double readVoltage = static_cast<eNVM*>(cell[colIndex][y])->readVoltage;
-				double totalWireResistance;
-				if (static_cast<eNVM*>(cell[colIndex][y])->cmosAccess) 
-					totalWireResistance = (colIndex + 1) * wireResistanceRow + (arrayRowSize - y) * wireResistanceCol + static_cast<eNVM*>(cell[colIndex][y])->resistanceAccess; 
-                else 
-					totalWireResistance = (colIndex + 1) * wireResistanceRow + (arrayRowSize - y) * wireResistanceCol;
+				int index = CellIndex(colIndex, y);
+				double totalWireResistance = readPathResistance[index];
 				double cellCurrent;
-				if (static_cast<eNVM*>(cell[colIndex][y])->nonlinearIV) {
+				if (cachedReadCurrent) {
+					cellCurrent = readCurrent[index];
+				}
+				else if (static_cast<eNVM*>(cell[colIndex][y])->nonlinearIV) {
 					/* Bisection method to calculate read current with nonlinearity */
 					int maxIter = 30;
 					double v1 = 0, v2 = readVoltage, v3;
@@ -145,11 +189,10 @@ double Array::ReadCell(int x, int y, char* mode) {
 				} 
                 else{ // No nonlinearity 
 					if (static_cast<eNVM*>(cell[colIndex][y])->readNoise){
-						extern std::mt19937 gen;
-						cellCurrent = readVoltage / (1/static_cast<eNVM*>(cell[colIndex][y])->conductance * (1 + (*static_cast<eNVM*>(cell[colIndex][y])->gaussian_dist)(gen)) + totalWireResistance);
+						cellCurrent = readVoltage / (1/conductance[index] * (1 + cell[colIndex][y]->ReadRandom().Normal(*static_cast<eNVM*>(cell[colIndex][y])->gaussian_dist)) + totalWireResistance);
 					} 
                     else 
-						cellCurrent = readVoltage / (1/static_cast<eNVM*>(cell[colIndex][y])->conductance + totalWireResistance);
+						cellCurrent = readVoltage / (1/conductance[index] + totalWireResistance);
 				}
 				// Current sensing
 				int bit;
@@ -172,7 +215,7 @@ double Array::ReadCell(int x, int y, char* mode) {
 void Array::WriteCell(int x, int y, double deltaWeight, double weight, double maxWeight, double minWeight, 
 						bool regular /* False: ideal write, True: regular write considering device properties */){
 	// TODO: include wire resistance
-	if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(**cell)){ // Analog eNVM
+	if (IsAnalogNVM()){ // Analog eNVM
         if (regular)	// Regular write
 			static_cast<AnalogNVM*>(cell[x][y])->Write(deltaWeight, weight, minWeight, maxWeight);
         else{	
@@ -186,8 +229,9 @@ void Array::WriteCell(int x, int y, double deltaWeight, double weight, double ma
 				conductance = minConductance;
 			static_cast<eNVM*>(cell[x][y])->conductance = conductance;
 		}
+		SyncCell(x, y);
 	}
-    else if(HybridCell*temp = dynamic_cast<HybridCell*>(**cell)){
+    else if(IsHybridCell()){
         double weightLSB = this->ConductanceToWeight(x,y, maxWeight, minWeight, "LSB");
 		
         if (regular) // Regular write
@@ -218,7 +262,7 @@ void Array::WriteCell(int x, int y, double deltaWeight, double weight, double ma
 		else if (targetWeightDigits < 0)
 			targetWeightDigits = 0;		
 		/* Write new weight and calculate write energy */
-		if (DigitalNVM *temp = dynamic_cast<DigitalNVM*>(**cell)){ // Digital eNVM
+		if (IsDigitalNVM()){ // Digital eNVM
 			for (int n=0; n<numCellPerSynapse; n++){ // n=0 is LSB
 				int bitNew = ((targetWeightDigits >> n) & 1); //get the nth bit to write to
 				/* Write new weight */
@@ -226,6 +270,7 @@ void Array::WriteCell(int x, int y, double deltaWeight, double weight, double ma
 					static_cast<DigitalNVM*>(cell[(x+1) * numCellPerSynapse - (n+1)][y])->Write(bitNew, wireCapBLCol);
                 else // Cross-point
 					static_cast<DigitalNVM*>(cell[(x+1) * numCellPerSynapse - (n+1)][y])->Write(bitNew, wireCapCol);
+				SyncCell((x+1) * numCellPerSynapse - (n+1), y);
 			}
 		} 
         else {
@@ -244,18 +289,159 @@ void Array::WriteCell(int x, int y, double deltaWeight, double weight, double ma
 }
 
 void Array::WirteCellWithNum(int x, int y, int numpulse, double weight, double maxWeight, double minWeight) {
-	static_cast<AnalogNVM*>(cell[x][y])->WriteWithNum(numpulse, weight, minWeight, maxWeight);
+	if (deviceType == REAL_DEVICE)	// Non-virtual call for the common case
+		static_cast<RealDevice*>(cell[x][y])->RealDevice::WriteWithNum(numpulse, weight, minWeight, maxWeight);
+	else
+		static_cast<AnalogNVM*>(cell[x][y])->WriteWithNum(numpulse, weight, minWeight, maxWeight);
+	SyncCell(x, y);
 }
 
 void Array::WriteCelltest(int x, int y, int numpulse, double weight, double maxWeight, double minWeight) {
-	static_cast<AnalogNVM*>(cell[x][y])->WriteWithNumtest(numpulse, weight, minWeight, maxWeight);
+	if (deviceType == REAL_DEVICE)	// Non-virtual call for the common case
+		static_cast<RealDevice*>(cell[x][y])->RealDevice::WriteWithNumtest(numpulse, weight, minWeight, maxWeight);
+	else
+		static_cast<AnalogNVM*>(cell[x][y])->WriteWithNumtest(numpulse, weight, minWeight, maxWeight);
+	SyncCell(x, y);
+}
+
+/* Copy the state of cell[x][y] to the structure-of-arrays store (call after any change of the cell outside Array) */
+void Array::SyncCell(int x, int y) {
+	if (!IsENVM()) {
+		return;
+	}
+	int index = CellIndex(x, y);
+	eNVM *envm = static_cast<eNVM*>(cell[x][y]);
+	conductance[index] = envm->conductance;
+	readCurrent[index] = envm->readVoltage / (1/envm->conductance + readPathResistance[index]);
+	double deltaHalfVwLTP = envm->conductanceAtHalfVwLTP - conductanceAtHalfVwLTP[index];
+	double deltaHalfVwLTD = envm->conductanceAtHalfVwLTD - conductanceAtHalfVwLTD[index];
+	if (deferColumnHalfVw) {	// Only the thread of row y writes the cells of the row
+		if (x < arrayColSize) {
+			rowHalfVwLTP[y] += deltaHalfVwLTP;
+			rowHalfVwLTD[y] += deltaHalfVwLTD;
+		}
+		columnHalfVwDeltaLTP[index] += deltaHalfVwLTP;
+		columnHalfVwDeltaLTD[index] += deltaHalfVwLTD;
+	} else if (deltaHalfVwLTP != 0 || deltaHalfVwLTD != 0) {	// E.g. the Hogwild training writes any cell from any thread
+		if (x < arrayColSize) {
+			#pragma omp atomic
+			rowHalfVwLTP[y] += deltaHalfVwLTP;
+			#pragma omp atomic
+			rowHalfVwLTD[y] += deltaHalfVwLTD;
+		}
+		#pragma omp atomic
+		columnHalfVwLTP[x] += deltaHalfVwLTP;
+		#pragma omp atomic
+		columnHalfVwLTD[x] += deltaHalfVwLTD;
+	}
+	conductanceAtHalfVwLTP[index] = envm->conductanceAtHalfVwLTP;
+	conductanceAtHalfVwLTD[index] = envm->conductanceAtHalfVwLTD;
+	if (IsAnalogNVM()) {
+		AnalogNVM *analog = static_cast<AnalogNVM*>(envm);
+		numPulse[index] = analog->numPulse;
+		writeLatencyLTP[index] = analog->writeLatencyLTP;
+		writeLatencyLTD[index] = analog->writeLatencyLTD;
+	}
+}
+
+/* Add the changes of the cells of row y to the column sums (call it for each row in row order after the WU, see DeferColumnHalfVw()) */
+void Array::MergeColumnHalfVw(int y) {
+	for (int x=0; x<numCellCols; x++) {
+		int index = CellIndex(x, y);
+		columnHalfVwLTP[x] += columnHalfVwDeltaLTP[index];
+		columnHalfVwLTD[x] += columnHalfVwDeltaLTD[index];
+		columnHalfVwDeltaLTP[index] = 0;
+		columnHalfVwDeltaLTD[index] = 0;
+	}
+}
+
+/* Recompute the half-selected conductance sums from the cells, which also drops the rounding error the running sums pick up over the updates */
+void Array::RebuildHalfVwSums() {
+	if (!IsENVM()) {
+		return;
+	}
+	for (int x=0; x<numCellCols; x++) {
+		columnHalfVwLTP[x] = columnHalfVwLTD[x] = 0;
+	}
+	for (int y=0; y<arrayRowSize; y++) {
+		double sumLTP = 0, sumLTD = 0;
+		for (int x=0; x<numCellCols; x++) {
+			int index = CellIndex(x, y);
+			if (x < arrayColSize) {
+				sumLTP += conductanceAtHalfVwLTP[index];
+				sumLTD += conductanceAtHalfVwLTD[index];
+			}
+			columnHalfVwLTP[x] += conductanceAtHalfVwLTP[index];
+			columnHalfVwLTD[x] += conductanceAtHalfVwLTD[index];
+		}
+		rowHalfVwLTP[y] = sumLTP;
+		rowHalfVwLTD[y] = sumLTD;
+	}
+}
+
+/* Rebuild the cached reference currents. Call it after changing the read voltage, access resistance or conductance range of the cells */
+void Array::UpdateReferenceCurrents() {
+	if (!IsAnalogNVM()) {
+		return;
+	}
+	for (int col=0; col<numCellCols; col++) {
+		double IsumMax = 0;
+		double IsumMin = 0;
+		for (int row=0; row<arrayRowSize; row++) {	// Same summation order as a column read
+			IsumMax += GetMaxCellReadCurrent(col, row);
+			IsumMin += GetMinCellReadCurrent(col, row);
+			mediumReadCurrent[CellIndex(col, row)] = GetMediumCellReadCurrent(col, row);
+		}
+		columnMaxReadCurrent[col] = IsumMax;
+		columnMinReadCurrent[col] = IsumMin;
+	}
+}
+
+/* Rebuild the read path resistance and the cached read currents. Call it after changing the wire resistance of the array */
+void Array::UpdateReadPath() {
+	cachedReadCurrent = IsENVM();
+	if (!IsENVM()) {
+		return;
+	}
+	for (int row=0; row<arrayRowSize; row++) {
+		for (int col=0; col<numCellCols; col++) {
+			eNVM *envm = static_cast<eNVM*>(cell[col][row]);
+			bool FeFET = IsAnalogNVM() && static_cast<AnalogNVM*>(envm)->FeFET;	// FeFET does not need the access resistance
+			double resistanceAccess = (envm->cmosAccess && !FeFET)? envm->resistanceAccess : 0;
+			readPathResistance[CellIndex(col, row)] = (col + 1) * wireResistanceRow + (arrayRowSize - row) * wireResistanceCol + resistanceAccess;
+			cachedReadCurrent = cachedReadCurrent && !envm->nonlinearIV && !envm->readNoise;
+			SyncCell(col, row);
+		}
+	}
+	RebuildHalfVwSums();
+	SelectReadKernel();
+}
+
+/* Set the write latency of cell[x][y] (e.g. to the max latency of its write batch) */
+void Array::SetWriteLatency(int x, int y, double latencyLTP, double latencyLTD) {
+	static_cast<AnalogNVM*>(cell[x][y])->writeLatencyLTP = latencyLTP;
+	static_cast<AnalogNVM*>(cell[x][y])->writeLatencyLTD = latencyLTD;
+	int index = CellIndex(x, y);
+	writeLatencyLTP[index] = latencyLTP;
+	writeLatencyLTD[index] = latencyLTD;
+}
+
+/* Leave cell[x][y] as a write of 0 pulses would, half-selected for the given latency of its write batch
+   (the sparse WU does not write the cells without a pulse, but their write energy is still counted) */
+void Array::SetHalfSelected(int x, int y, double latencyLTP, double latencyLTD) {
+	AnalogNVM *analog = static_cast<AnalogNVM*>(cell[x][y]);
+	analog->numPulse = 0;
+	analog->conductancePrev = analog->conductance;
+	analog->writeVoltageSquareSum = 0;
+	numPulse[CellIndex(x, y)] = 0;
+	SetWriteLatency(x, y, latencyLTP, latencyLTD);
 }
 
 double Array::GetMaxCellReadCurrent(int x, int y, char* mode) { 
     // two mode: "LSB", "MSB". For hybrid cell only
-    if(AnalogNVM*temp = dynamic_cast<AnalogNVM*>(**cell)) 
+    if(IsAnalogNVM()) 
 	    return static_cast<AnalogNVM*>(cell[x][y])->GetMaxReadCurrent();
-    else if (HybridCell* temp = dynamic_cast<HybridCell*>(**cell)){   
+    else if (IsHybridCell()){   
         if(mode=="LSB")
             return static_cast<HybridCell*>(cell[x][y])->LSBcell.GetMaxReadCurrent();
         else if(mode =="MSB")
@@ -267,9 +453,9 @@ double Array::GetMaxCellReadCurrent(int x, int y, char* mode) {
 
 double Array::GetMinCellReadCurrent(int x, int y, char*mode) {
     // two mode: "LSB", "MSB". For hybrid cell only
-    if(AnalogNVM*temp = dynamic_cast<AnalogNVM*>(**cell)) 
+    if(IsAnalogNVM()) 
 	    return static_cast<AnalogNVM*>(cell[x][y])->GetMinReadCurrent();
-    else if (HybridCell* temp = dynamic_cast<HybridCell*>(**cell)){   
+    else if (IsHybridCell()){   
         if(mode=="LSB")
             return static_cast<HybridCell*>(cell[x][y])->LSBcell.GetMinReadCurrent();
         else if(mode =="MSB")
@@ -281,11 +467,11 @@ double Array::GetMinCellReadCurrent(int x, int y, char*mode) {
 
 double Array::GetMediumCellReadCurrent(int x, int y) {  
     double Imax, Imin;
-    if(AnalogNVM*temp = dynamic_cast<AnalogNVM*>(**cell)){
+    if(IsAnalogNVM()){
 	     Imax = static_cast<AnalogNVM*>(cell[x][y])->GetMaxReadCurrent();
          Imin = static_cast<AnalogNVM*>(cell[x][y])->GetMinReadCurrent();
     }
-    else if(HybridCell*temp = dynamic_cast<HybridCell*>(**cell)){
+    else if(IsHybridCell()){
              Imax = static_cast<HybridCell*>(cell[x][y])->LSBcell.GetMaxReadCurrent();
 	         Imin = static_cast<HybridCell*>(cell[x][y])->LSBcell.GetMinReadCurrent();
     }
@@ -294,7 +480,7 @@ double Array::GetMediumCellReadCurrent(int x, int y) {
 
 // convert the conductance to -1~1 
 double Array::ConductanceToWeight(int x, int y, double maxWeight, double minWeight, char* mode) {
-	if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(**cell)){	// Analog eNVM
+	if (IsAnalogNVM()){	// Analog eNVM
 		/* Measure current */
 		double I = this->ReadCell(x, y); // for AnalogNVM, read the current and convert it into conductance
 		/* Convert current to weight */
@@ -306,7 +492,7 @@ double Array::ConductanceToWeight(int x, int y, double maxWeight, double minWeig
 			I = Imax;
 		return (I-Imin) / (Imax-Imin) * (maxWeight-minWeight) + minWeight;
 	}
-    else if (HybridCell *temp = dynamic_cast<HybridCell*>(**cell)){
+    else if (IsHybridCell()){
 		double I = this->ReadCell(x, y,"LSB"); // for 3T1C cell, read the current and convert it into conductance
 		double Imax = static_cast<HybridCell*>(cell[x][y])->LSBcell.GetMaxReadCurrent(); // the current when Conductance is the minimum
 		double Imin = static_cast<HybridCell*>(cell[x][y])->LSBcell.GetMinReadCurrent(); // the current when Conductance is the maximum
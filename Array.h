@@ -39,9 +39,33 @@
 #ifndef ARRAY_H_
 #define ARRAY_H_
 
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <new>
 #include "Cell.h"
 
+/* Device type of the cells in an array, decided at compile time by Initialization<memoryType>() */
+enum DeviceType { IDEAL_DEVICE, REAL_DEVICE, MEASURED_DEVICE, _2T1F_DEVICE, DIGITAL_NVM, SRAM_CELL, HYBRID_CELL };
+
+template <class memoryType> struct DeviceTypeOf;
+template <> struct DeviceTypeOf<IdealDevice> { static const DeviceType value = IDEAL_DEVICE; };
+template <> struct DeviceTypeOf<RealDevice> { static const DeviceType value = REAL_DEVICE; };
+template <> struct DeviceTypeOf<MeasuredDevice> { static const DeviceType value = MEASURED_DEVICE; };
+template <> struct DeviceTypeOf<_2T1F> { static const DeviceType value = _2T1F_DEVICE; };
+template <> struct DeviceTypeOf<DigitalNVM> { static const DeviceType value = DIGITAL_NVM; };
+template <> struct DeviceTypeOf<SRAM> { static const DeviceType value = SRAM_CELL; };
+template <> struct DeviceTypeOf<HybridCell> { static const DeviceType value = HYBRID_CELL; };
+
+/* Read configuration of the analog eNVM cells, fixed for a run. The cell read is instantiated for each device type and
+   configuration, and UpdateReadPath() picks the matching instantiation once, so the read path does not test these flags per cell */
+enum ReadConfig {
+	READ_CACHED = 1,		// Linear I-V and no read noise: the read current is cached in readCurrent
+	READ_NONLINEAR_IV = 2,	// Bisection on the nonlinear I-V curve
+	READ_NOISE = 4,			// Gaussian read noise
+	READ_MIXED = 8			// The cells differ in the flags above, which are then tested per cell
+};
+
 class Array {
 public:
 	Cell ***cell;
@@ -58,10 +82,46 @@ public:
 	double writeEnergySRAMCell;	// Write energy per SRAM cell (will move this to SRAM cell level in the future)
 	bool **weightChange;	// Specify if the weight value will change or not during weight update (for SRAM and digital eNVM)
     int refColumnNumber;
+	int layer;	// Synaptic layer of the array (0: input to hidden, 1: hidden to output), keys the random streams of its cells
+
+	/* Structure-of-arrays copy of the hot cell state, row-major (index = row*numCellCols+col) to follow the weight update loops.
+	   The Cell objects still model the device physics, and SyncCell() copies their state here after every write */
+	int numCellCols;	// # of cell columns (including the reference columns)
+	DeviceType deviceType;	// Cell type, decided once in Initialization() (no RTTI check in the read/write paths)
+	void *cellStorage;	// Contiguous storage of all the Cell objects (row-major)
+	double *conductance;	// Cell conductance (S)
+	double *readPathResistance;	// Wire and access resistance in the read path of each cell (Ohm), see UpdateReadPath()
+	double *readCurrent;	// Noiseless read current of each cell including the wire parasitics (A), updated on every write
+	bool cachedReadCurrent;	// All cells are read from readCurrent (no read noise and no I-V nonlinearity)
+	int readConfig;			// ReadConfig of the cells (analog eNVM)
+	typedef double (Array::*ReadKernel)(int x, int y);
+	ReadKernel readAnalogCell;	// Instantiation of ReadAnalogCell() for deviceType and readConfig
+	double *conductanceAtHalfVwLTP;	// Conductance at 1/2 LTP write voltage (for half-selected cells)
+	double *conductanceAtHalfVwLTD;	// Conductance at 1/2 LTD write voltage (for half-selected cells)
+	/* Running sums of conductanceAtHalfVwLTP/LTD for the half-selected cell energy of cross-point arrays, kept up to date by SyncCell()
+	   and rebuilt by RebuildHalfVwSums() */
+	double *rowHalfVwLTP;	// Sum over the synapse columns (without the reference columns) of each row
+	double *rowHalfVwLTD;
+	double *columnHalfVwLTP;	// Sum over all the rows of each cell column
+	double *columnHalfVwLTD;
+	/* Between DeferColumnHalfVw(true) and (false), the rows of the WU run on different threads: SyncCell() keeps the change of each
+	   cell here instead, so the column sums stay at their value before the WU until MergeColumnHalfVw() adds the rows in row order */
+	bool deferColumnHalfVw;
+	double *columnHalfVwDeltaLTP;	// Change of conductanceAtHalfVwLTP of each cell (row-major) not yet in columnHalfVwLTP
+	double *columnHalfVwDeltaLTD;
+	int *numPulse;	// # of write pulses in the most recent write operation (AnalogNVM)
+	double *writeLatencyLTP;	// Write latency of LTP in the most recent write operation (AnalogNVM)
+	double *writeLatencyLTD;	// Write latency of LTD in the most recent write operation (AnalogNVM)
+	/* Reference currents of analog eNVM, which only depend on the device range parameters (see UpdateReferenceCurrents()) */
+	double *columnMaxReadCurrent;	// Sum of GetMaxCellReadCurrent over all the rows of each cell column
+	double *columnMinReadCurrent;	// Sum of GetMinCellReadCurrent over all the rows of each cell column
+	double *mediumReadCurrent;	// GetMediumCellReadCurrent of each cell (row-major)
+
 	/* Constructor */
     // code modified
-	Array(int arrayColSize, int arrayRowSize, int wireWidth) {  
+	Array(int arrayColSize, int arrayRowSize, int wireWidth, int layer=0) {  
         this->arrayRowSize = arrayRowSize;
+        this->layer = layer;
         this->arrayColSize = arrayColSize;
         this->wireWidth = wireWidth;
 		readEnergy = 0;
@@ -69,6 +129,18 @@ public:
         transferReadEnergy = transferWriteEnergy = 0;
         transferEnergy = 0;
 
+		cellStorage = NULL;
+		conductance = readPathResistance = readCurrent = conductanceAtHalfVwLTP = conductanceAtHalfVwLTD = NULL;
+		writeLatencyLTP = writeLatencyLTD = NULL;
+		numPulse = NULL;
+		rowHalfVwLTP = rowHalfVwLTD = columnHalfVwLTP = columnHalfVwLTD = NULL;
+		deferColumnHalfVw = false;
+		columnHalfVwDeltaLTP = columnHalfVwDeltaLTD = NULL;
+		cachedReadCurrent = false;
+		readConfig = 0;
+		readAnalogCell = NULL;
+		columnMaxReadCurrent = columnMinReadCurrent = mediumReadCurrent = NULL;
+
 		/* Initialize weightChange */
 		weightChange = new bool*[arrayColSize];
 		for (int col=0; col<arrayColSize; col++) {
@@ -87,18 +159,26 @@ public:
             cellsPerRow = arrayColSize*numCellPerSynapse+2;
         else
             cellsPerRow = arrayColSize*numCellPerSynapse;
+        numCellCols = cellsPerRow;
+        /* All cells live in one aligned block in row-major order, and cell[col][row] points into it.
+           The construction order is kept column by column so that the device variations are drawn as before. */
+        int numCells = cellsPerRow * arrayRowSize;
+        memoryType *cellBlock = AllocateAligned<memoryType>(numCells);
+        cellStorage = cellBlock;
         cell = new Cell**[cellsPerRow];
 		for (int col=0; col<cellsPerRow; col++) {
 			cell[col] = new Cell*[arrayRowSize];
 			for (int row=0; row<arrayRowSize; row++) {
-				cell[col][row] = new memoryType(col, row);
+				cell[col][row] = new (&cellBlock[CellIndex(col, row)]) memoryType(col, row);
+				cell[col][row]->SetRandomStream(RandomStreamId(RANDOM_ARRAY_IH + layer, CellIndex(col, row)));
 			}
 		}
+		deviceType = DeviceTypeOf<memoryType>::value;
         // initialize the conductance of the reference column
         if(refColumn = true)
         {
             refColumnNumber = arrayColSize*numCellPerSynapse; // the column number of the first reference column
-            if(DigitalNVM *temp = dynamic_cast<DigitalNVM*>(this->cell[0][0]))
+            if(IsDigitalNVM())
             {
                 for(int row=0; row < this-> arrayRowSize; row++)
                 {
@@ -107,6 +187,33 @@ public:
                 }
             }    
         }
+
+		/* Initialize the structure-of-arrays store */
+		conductance = AllocateAligned<double>(numCells);
+		readPathResistance = AllocateAligned<double>(numCells);
+		readCurrent = AllocateAligned<double>(numCells);
+		conductanceAtHalfVwLTP = AllocateAligned<double>(numCells);
+		conductanceAtHalfVwLTD = AllocateAligned<double>(numCells);
+		numPulse = AllocateAligned<int>(numCells);
+		writeLatencyLTP = AllocateAligned<double>(numCells);
+		writeLatencyLTD = AllocateAligned<double>(numCells);
+		rowHalfVwLTP = AllocateAligned<double>(arrayRowSize);
+		rowHalfVwLTD = AllocateAligned<double>(arrayRowSize);
+		columnHalfVwLTP = AllocateAligned<double>(cellsPerRow);
+		columnHalfVwLTD = AllocateAligned<double>(cellsPerRow);
+		columnHalfVwDeltaLTP = AllocateAligned<double>(numCells);
+		columnHalfVwDeltaLTD = AllocateAligned<double>(numCells);
+		if (IsENVM()) {
+			for (int row=0; row<arrayRowSize; row++) {
+				for (int col=0; col<cellsPerRow; col++) {
+					SyncCell(col, row);
+				}
+			}
+		}
+		columnMaxReadCurrent = AllocateAligned<double>(cellsPerRow);
+		columnMinReadCurrent = AllocateAligned<double>(cellsPerRow);
+		mediumReadCurrent = AllocateAligned<double>(numCells);
+		UpdateReferenceCurrents();
 		
 		/* Initialize interconnect wires */
 		double AR;	// Aspect ratio of wire height to wire width
@@ -136,9 +243,39 @@ public:
 		wireCapRow = wireLength * 0.2e-15/1e-6;
 		wireCapCol = wireLength * 0.2e-15/1e-6;
 		wireGateCapRow = wireLength * 0.2e-15/1e-6;
-		
+
+		UpdateReadPath();
+	}
+
+	template <class T>
+	static T *AllocateAligned(int n) {	// Zero-initialized storage aligned to the cache line
+		void *ptr = NULL;
+		if (posix_memalign(&ptr, 64, sizeof(T) * (size_t)n) != 0) {
+			puts("Cannot allocate the array storage");
+			exit(-1);
+		}
+		memset(ptr, 0, sizeof(T) * (size_t)n);
+		return (T *)ptr;
 	}
+	bool IsAnalogNVM() const { return deviceType == IDEAL_DEVICE || deviceType == REAL_DEVICE || deviceType == MEASURED_DEVICE || deviceType == _2T1F_DEVICE; }
+	bool IsDigitalNVM() const { return deviceType == DIGITAL_NVM; }
+	bool IsENVM() const { return IsAnalogNVM() || IsDigitalNVM(); }
+	bool IsSRAM() const { return deviceType == SRAM_CELL; }
+	bool IsHybridCell() const { return deviceType == HYBRID_CELL; }
+	bool Is2T1F() const { return deviceType == _2T1F_DEVICE; }
+	int CellIndex(int x, int y) const { return y * numCellCols + x; }	// Index of cell[x][y] in the structure-of-arrays store
+	void SyncCell(int x, int y);
+	void DeferColumnHalfVw(bool defer) { deferColumnHalfVw = defer; }
+	void MergeColumnHalfVw(int y);
+	void RebuildHalfVwSums();
+	void SetWriteLatency(int x, int y, double latencyLTP, double latencyLTD);
+	void SetHalfSelected(int x, int y, double latencyLTP, double latencyLTD);
+	void UpdateReferenceCurrents();
+	void UpdateReadPath();
 
+	template <class DeviceT, int config> double ReadAnalogCell(int x, int y);
+	template <class DeviceT> ReadKernel ReadKernelOf(int config);
+	void SelectReadKernel();
 	double ReadCell(int x, int y,char*mode=NULL);	// x (column) and y (row) start from index 0
 	void WriteCell(int x, int y, double deltaWeight, double weight, double maxWeight, double minWeight, bool regular);
 	double GetMaxCellReadCurrent(int x, int y, char*mode=NULL);
@@ -151,6 +151,23 @@ void AnalogNVM::WriteEnergyCalculation(double wireCapCol) {
 	}
 }
 
+/* Device-to-device variation of the conductance range, drawn once per cell from its own stream (see SetRandomStream()) */
+void eNVM::DrawConductanceRangeVar(RandomStream &random) {
+	if (conductanceRangeVar) {
+		maxConductance += random.Normal(*gaussian_dist_maxConductance);
+		minConductance += random.Normal(*gaussian_dist_minConductance);
+		if (minConductance >= maxConductance || maxConductance < 0 || minConductance < 0 ) {	// Conductance variation check
+			puts("[Error] Conductance variation check not passed. The variation may be too large.");
+			exit(-1);
+		}
+		// Use the code below instead for re-choosing the variation if the check is not passed
+		//do {
+		//	maxConductance = avgMaxConductance + random.Normal(*gaussian_dist_maxConductance);
+		//	minConductance = avgMinConductance + random.Normal(*gaussian_dist_minConductance);
+		//} while (minConductance >= maxConductance || maxConductance < 0 || minConductance < 0);
+	}
+}
+
 /* Ideal device (no weight update nonlinearity) */
 IdealDevice::IdealDevice(int x, int y) {
 	this->x = x; this->y = y;	// Cell location: x (column) and y (row) start from index 0
@@ -192,40 +209,29 @@ IdealDevice::IdealDevice(int x, int y) {
 	conductanceRangeVar = false;	// Consider variation of conductance range or not
 	maxConductanceVar = 0;	// Sigma of maxConductance variation (S)
 	minConductanceVar = 0;	// Sigma of minConductance variation (S)
-	std::mt19937 localGen;
-	localGen.seed(std::time(0));
 	gaussian_dist_maxConductance = new std::normal_distribution<double>(0, maxConductanceVar);
 	gaussian_dist_minConductance = new std::normal_distribution<double>(0, minConductanceVar);
-	if (conductanceRangeVar) {
-		maxConductance += (*gaussian_dist_maxConductance)(localGen);
-		minConductance += (*gaussian_dist_minConductance)(localGen);
-		if (minConductance >= maxConductance || maxConductance < 0 || minConductance < 0 ) {	// Conductance variation check
-			puts("[Error] Conductance variation check not passed. The variation may be too large.");
-			exit(-1);
-		}
-		// Use the code below instead for re-choosing the variation if the check is not passed
-		//do {
-		//	maxConductance = avgMaxConductance + (*gaussian_dist_maxConductance)(localGen);
-		//	minConductance = avgMinConductance + (*gaussian_dist_minConductance)(localGen);
-		//} while (minConductance >= maxConductance || maxConductance < 0 || minConductance < 0);
-	}
 	
 	heightInFeatureSize = cmosAccess? 4 : 2;	// Cell height = 4F (Pseudo-crossbar) or 2F (cross-point)
 	widthInFeatureSize = cmosAccess? (FeFET? 6 : 4) : 2;	// Cell width = 6F (FeFET) or 4F (Pseudo-crossbar) or 2F (cross-point)
 }
 
+void IdealDevice::SetRandomStream(uint32_t id) {
+	randomStreamId = id;
+	RandomStream random = RandomStream::DeviceVariation(id);
+	DrawConductanceRangeVar(random);
+}
+
 double IdealDevice::Read(double voltage) {
-	extern std::mt19937 gen;
 	// TODO: nonlinear read
 	if (readNoise) {
-		return voltage * conductance * (1 + (*gaussian_dist)(gen));
+		return voltage * conductance * (1 + ReadRandom().Normal(*gaussian_dist));
 	} else {
 		return voltage * conductance;
 	}
 }
 
 void IdealDevice::Write(double deltaWeightNormalized, double weight, double minWeight, double maxWeight) {
-	extern std::mt19937 gen;
 	if (deltaWeightNormalized >= 0) {
 		deltaWeightNormalized = deltaWeightNormalized/(maxWeight-minWeight);
 		deltaWeightNormalized = truncate(deltaWeightNormalized, maxNumLevelLTP);
@@ -303,16 +309,13 @@ RealDevice::RealDevice(int x, int y) {
 	sigmaReadNoise = 0;		// Sigma of read noise in gaussian distribution
 	gaussian_dist = new std::normal_distribution<double>(0, sigmaReadNoise);	// Set up mean and stddev for read noise
 
-	std::mt19937 localGen;	// It's OK not to use the external gen, since here the device-to-device vairation is a one-time deal
-	localGen.seed(std::time(0));
-	
 	/* Device-to-device weight update variation */
 	NL_LTP = 2.4;	// LTP nonlinearity
 	NL_LTD = -4.88;	// LTD nonlinearity
 	sigmaDtoD = 0;	// Sigma of device-to-device weight update vairation in gaussian distribution
 	gaussian_dist2 = new std::normal_distribution<double>(0, sigmaDtoD);	// Set up mean and stddev for device-to-device weight update vairation
-	paramALTP = getParamA(NL_LTP + (*gaussian_dist2)(localGen)) * maxNumLevelLTP;	// Parameter A for LTP nonlinearity
-	paramALTD = getParamA(NL_LTD + (*gaussian_dist2)(localGen)) * maxNumLevelLTD;	// Parameter A for LTD nonlinearity
+	paramALTP = getParamA(NL_LTP) * maxNumLevelLTP;	// Parameter A for LTP nonlinearity
+	paramALTD = getParamA(NL_LTD) * maxNumLevelLTD;	// Parameter A for LTD nonlinearity
 
 	/* Cycle-to-cycle weight update variation */
 	sigmaCtoC = 0.035* (maxConductance - minConductance);	// Sigma of cycle-to-cycle weight update vairation: defined as the percentage of conductance range
@@ -324,36 +327,30 @@ RealDevice::RealDevice(int x, int y) {
 	minConductanceVar = 0;  // Sigma of minConductance variation (S)
 	gaussian_dist_maxConductance = new std::normal_distribution<double>(0, maxConductanceVar);
 	gaussian_dist_minConductance = new std::normal_distribution<double>(0, minConductanceVar);
-	if (conductanceRangeVar) {
-		maxConductance += (*gaussian_dist_maxConductance)(localGen);
-		minConductance += (*gaussian_dist_minConductance)(localGen);
-		if (minConductance >= maxConductance || maxConductance < 0 || minConductance < 0 ) {    // Conductance variation check
-			puts("[Error] Conductance variation check not passed. The variation may be too large.");
-			exit(-1);
-		}
-		// Use the code below instead for re-choosing the variation if the check is not passed
-		//do {
-		//  maxConductance = avgMaxConductance + (*gaussian_dist_maxConductance)(localGen);
-		//  minConductance = avgMinConductance + (*gaussian_dist_minConductance)(localGen);
-		//} while (minConductance >= maxConductance || maxConductance < 0 || minConductance < 0);
-	}
  
         heightInFeatureSize = cmosAccess? 4 : 2; // Cell height = 4F (Pseudo-crossbar) or 2F (cross-point)
         widthInFeatureSize = cmosAccess? (FeFET? 6 : 4) : 2; //// Cell width = 6F (FeFET) or 4F (Pseudo-crossbar) or 2F (cross-point)
 }
+
+void RealDevice::SetRandomStream(uint32_t id) {
+	randomStreamId = id;
+	RandomStream random = RandomStream::DeviceVariation(id);
+	paramALTP = getParamA(NL_LTP + random.Normal(*gaussian_dist2)) * maxNumLevelLTP;	// Parameter A for LTP nonlinearity
+	paramALTD = getParamA(NL_LTD + random.Normal(*gaussian_dist2)) * maxNumLevelLTD;	// Parameter A for LTD nonlinearity
+	DrawConductanceRangeVar(random);
+}
  
 double RealDevice::Read(double voltage) {	// Return read current (A)
-	extern std::mt19937 gen;
 	if (nonlinearIV) {
 		// TODO: nonlinear read
 		if (readNoise) {
-			return voltage * conductance * (1 + (*gaussian_dist)(gen));
+			return voltage * conductance * (1 + ReadRandom().Normal(*gaussian_dist));
 		} else {
 			return voltage * conductance;
 		}
 	} else {
 		if (readNoise) {
-			return voltage * conductance * (1 + (*gaussian_dist)(gen));
+			return voltage * conductance * (1 + ReadRandom().Normal(*gaussian_dist));
 		} else {
 			return voltage * conductance;
 		}
@@ -389,9 +386,8 @@ void RealDevice::Write(double deltaWeightNormalized, double weight, double minWe
 	}
 
 	/* Cycle-to-cycle variation */
-	extern std::mt19937 gen;
 	if (sigmaCtoC && numPulse != 0) {
-		conductanceNew += (*gaussian_dist3)(gen) * sqrt(abs(numPulse));	// Absolute variation
+		conductanceNew += WriteRandom().Normal(*gaussian_dist3) * sqrt(abs(numPulse));	// Absolute variation
 	}
 	
 	if (conductanceNew > maxConductance) {
@@ -454,10 +450,9 @@ void RealDevice::WriteWithNum(int numpulse, double weight, double minWeight, dou
 
 
 	/* Cycle-to-cycle variation */
-	extern std::mt19937 gen;
 	if (sigmaCtoC && numpulse != 0)
 	{
-		conductanceNew += (*gaussian_dist3)(gen)*sqrt(abs(numpulse)); // Absolute variation
+		conductanceNew += WriteRandom().Normal(*gaussian_dist3)*sqrt(abs(numpulse)); // Absolute variation
 	}
 
 	if (conductanceNew > maxConductance)
@@ -522,10 +517,9 @@ void RealDevice::WriteWithNumtest(int numpulse, double weight, double minWeight,
 
 
 	/* Cycle-to-cycle variation */
-	extern std::mt19937 gen;
 	if (sigmaCtoC && numpulse != 0)
 	{
-		conductanceNew += (*gaussian_dist3)(gen)*sqrt(abs(numpulse)); // Absolute variation
+		conductanceNew += WriteRandom().Normal(*gaussian_dist3)*sqrt(abs(numpulse)); // Absolute variation
 	}
 
 	if (conductanceNew > maxConductance)
@@ -582,6 +576,7 @@ void RealDevice::WriteWithNumtest(int numpulse, double weight, double minWeight,
 		}
 	}
 
+	numPulse = numpulse;
 	conductancePrev = conductance;
 	conductance = conductanceNew;
 }
@@ -670,17 +665,16 @@ MeasuredDevice::MeasuredDevice(int x, int y) {
 }
 
 double MeasuredDevice::Read(double voltage) {	// Return read current (A)
-	extern std::mt19937 gen;
 	if (nonlinearIV) {
 		// TODO: nonlinear read
 		if (readNoise) {
-			return voltage * conductance * (1 + (*gaussian_dist)(gen));
+			return voltage * conductance * (1 + ReadRandom().Normal(*gaussian_dist));
 		} else {
 			return voltage * conductance;
 		}
 	} else {
 		if (readNoise) {
-			return voltage * conductance * (1 + (*gaussian_dist)(gen));
+			return voltage * conductance * (1 + ReadRandom().Normal(*gaussian_dist));
 		} else {
 			return voltage * conductance;
 		}
@@ -822,40 +816,30 @@ DigitalNVM::DigitalNVM(int x, int y) {
 	conductanceRangeVar =false;    // Consider variation of conductance range or not
 	maxConductanceVar = 0.07*maxConductance;  // Sigma of maxConductance variation (S)
 	minConductanceVar = 0.07*minConductance;  // Sigma of minConductance variation (S)
-	std::mt19937 localGen;
-	localGen.seed(std::time(0));
 	gaussian_dist_maxConductance = new std::normal_distribution<double>(0, maxConductanceVar);
 	gaussian_dist_minConductance = new std::normal_distribution<double>(0, minConductanceVar);
-	if (conductanceRangeVar) {
-		maxConductance += (*gaussian_dist_maxConductance)(localGen);
-		minConductance += (*gaussian_dist_minConductance)(localGen);
-	if (minConductance >= maxConductance || maxConductance < 0 || minConductance < 0 ) {    // Conductance variation check
-			puts("[Error] Conductance variation check not passed. The variation may be too large.");
-			exit(-1);
-		}
-		// Use the code below instead for re-choosing the variation if the check is not passed
-		//do {
-		//  maxConductance = avgMaxConductance + (*gaussian_dist_maxConductance)(localGen);
-		//  minConductance = avgMinConductance + (*gaussian_dist_minConductance)(localGen);
-		//} while (minConductance >= maxConductance || maxConductance < 0 || minConductance < 0);
-	}
 
 	heightInFeatureSize = cmosAccess? 4 : 2;	// Cell height = 4F (1T1R) or 2F (cross-point)
 	widthInFeatureSize = cmosAccess? 8 : 2;	// Cell width = 4F (1T1R) or 2F (cross-point) default cell width = 8F, can reduce it to 4F if the cell Ron is increased
 }
 
+void DigitalNVM::SetRandomStream(uint32_t id) {
+	randomStreamId = id;
+	RandomStream random = RandomStream::DeviceVariation(id);
+	DrawConductanceRangeVar(random);
+}
+
 double DigitalNVM::Read(double voltage) {	// Return read current (A)
-	extern std::mt19937 gen;
 	if (nonlinearIV) {
 		// TODO: nonlinear read
 		if (readNoise) {
-			return voltage * conductance * (1 + (*gaussian_dist)(gen));
+			return voltage * conductance * (1 + ReadRandom().Normal(*gaussian_dist));
 		} else {
 			return voltage * conductance;
 		}
 	} else {
 		if (readNoise) {
-			return voltage * conductance * (1 + (*gaussian_dist)(gen));
+			return voltage * conductance * (1 + ReadRandom().Normal(*gaussian_dist));
 		} else {
 			return voltage * conductance;
 		}
@@ -967,16 +951,13 @@ _3T1C:: _3T1C(int x, int y) {
 
 	nonlinearWrite = true;	// Consider weight update nonlinearity or not
 
-	std::mt19937 localGen;	// It's OK not to use the external gen, since here the device-to-device vairation is a one-time deal
-	localGen.seed(std::time(0));
-	
 	/* Device-to-device weight update variation */
 	NL_LTP = 0.2;	// LTP nonlinearity
 	NL_LTD = -0.2;  // LTD nonlinearity
 	sigmaDtoD = 0;	// Sigma of device-to-device weight update vairation in gaussian distribution
 	gaussian_dist2 = new std::normal_distribution<double>(0, sigmaDtoD);	        // Set up mean and stddev for device-to-device weight update vairation
-	paramALTP = getParamA(NL_LTP + (*gaussian_dist2)(localGen)) * maxNumLevelLTP;	// Parameter A for LTP nonlinearity
-	paramALTD = getParamA(NL_LTD + (*gaussian_dist2)(localGen)) * maxNumLevelLTD;	// Parameter A for LTD nonlinearity
+	paramALTP = getParamA(NL_LTP) * maxNumLevelLTP;	// Parameter A for LTP nonlinearity
+	paramALTD = getParamA(NL_LTD) * maxNumLevelLTD;	// Parameter A for LTD nonlinearity
 
 	/* Cycle-to-cycle weight update variation */
 	sigmaCtoC = 0.005 * (maxConductance - minConductance);	                // Sigma of cycle-to-cycle weight update vairation: defined as the percentage of conductance range
@@ -988,21 +969,26 @@ _3T1C:: _3T1C(int x, int y) {
 	minConductanceVar = 0;          // Sigma of minConductance variation (S)
 	gaussian_dist_maxConductance = new std::normal_distribution<double>(0, maxConductanceVar);
 	gaussian_dist_minConductance = new std::normal_distribution<double>(0, minConductanceVar);
+}
+
+void _3T1C::SetRandomStream(uint32_t id) {
+	randomStreamId = id;
+	RandomStream random = RandomStream::DeviceVariation(id);
+	paramALTP = getParamA(NL_LTP + random.Normal(*gaussian_dist2)) * maxNumLevelLTP;	// Parameter A for LTP nonlinearity
+	paramALTD = getParamA(NL_LTD + random.Normal(*gaussian_dist2)) * maxNumLevelLTD;	// Parameter A for LTD nonlinearity
 	if (conductanceRangeVar) {
-		maxConductance += (*gaussian_dist_maxConductance)(localGen);
-		minConductance += (*gaussian_dist_minConductance)(localGen);
-		if (minConductance >= maxConductance || maxConductance < 0 || minConductance < 0 ) 
-        {    // Conductance variation check
+		maxConductance += random.Normal(*gaussian_dist_maxConductance);
+		minConductance += random.Normal(*gaussian_dist_minConductance);
+		if (minConductance >= maxConductance || maxConductance < 0 || minConductance < 0 ) {	// Conductance variation check
 			puts("[Error] Conductance variation check not passed. The variation may be too large.");
 			exit(-1);
-        }
-}
+		}
+	}
 }
 
 double _3T1C::Read(double voltage) {
-	extern std::mt19937 gen;
 		if (readNoise) {
-			return voltage * conductance * (1 + (*gaussian_dist)(gen));
+			return voltage * conductance * (1 + ReadRandom().Normal(*gaussian_dist));
 		} else {
 			return voltage * conductance;
 		}
@@ -1059,9 +1045,8 @@ void _3T1C::Write(double deltaWeightNormalized, double weight, double minWeight,
 }
 
     /* Cycle-to-cycle variation */
-	extern std::mt19937 gen;
 	if (sigmaCtoC && numPulse != 0) {
-		conductanceNew += (*gaussian_dist3)(gen) * sqrt(abs(numPulse));	// Absolute variation
+		conductanceNew += WriteRandom().Normal(*gaussian_dist3) * sqrt(abs(numPulse));	// Absolute variation
 	}
 	
 	if (conductanceNew > maxConductance) {
@@ -1311,16 +1296,13 @@ _2T1F::_2T1F(int x, int y) {
 	sigmaReadNoise = 0;		// Sigma of read noise in gaussian distribution
 	gaussian_dist = new std::normal_distribution<double>(0, sigmaReadNoise);	// Set up mean and stddev for read noise
          
-	std::mt19937 localGen;	// It's OK not to use the external gen, since here the device-to-device vairation is a one-time deal
-	localGen.seed(std::time(0));
-     
 	/* Device-to-device weight update variation */
 	NL_LTP = 0.5;	// LTP nonlinearity
 	NL_LTD = 0.5;	// LTD nonlinearity
 	sigmaDtoD = 0;	// Sigma of device-to-device weight update vairation in gaussian distribution
 	gaussian_dist2 = new std::normal_distribution<double>(0, sigmaDtoD);	// Set up mean and stddev for device-to-device weight update vairation
-	paramALTP = getParamA(NL_LTP + (*gaussian_dist2)(localGen)) * maxNumLevelLTP;	// Parameter A for LTP nonlinearity
-	paramALTD = getParamA(NL_LTD + (*gaussian_dist2)(localGen)) * maxNumLevelLTD;	// Parameter A for LTD nonlinearity
+	paramALTP = getParamA(NL_LTP) * maxNumLevelLTP;	// Parameter A for LTP nonlinearity
+	paramALTD = getParamA(NL_LTD) * maxNumLevelLTD;	// Parameter A for LTD nonlinearity
 
 	/* Cycle-to-cycle weight update variation */
 	sigmaCtoC = 0.005* (maxConductance - minConductance);	// Sigma of cycle-to-cycle weight update vairation: defined as the percentage of conductance range
@@ -1332,20 +1314,19 @@ _2T1F::_2T1F(int x, int y) {
 	minConductanceVar = 0;          // Sigma of minConductance variation (S)
 	gaussian_dist_maxConductance = new std::normal_distribution<double>(0, maxConductanceVar);
 	gaussian_dist_minConductance = new std::normal_distribution<double>(0, minConductanceVar);
-	if (conductanceRangeVar) {
-		maxConductance += (*gaussian_dist_maxConductance)(localGen);
-		minConductance += (*gaussian_dist_minConductance)(localGen);
-		if (minConductance >= maxConductance || maxConductance < 0 || minConductance < 0 ) {    // Conductance variation check
-			puts("[Error] Conductance variation check not passed. The variation may be too large.");
-			exit(-1);
-		}
-	}
  }
+
+void _2T1F::SetRandomStream(uint32_t id) {
+	randomStreamId = id;
+	RandomStream random = RandomStream::DeviceVariation(id);
+	paramALTP = getParamA(NL_LTP + random.Normal(*gaussian_dist2)) * maxNumLevelLTP;	// Parameter A for LTP nonlinearity
+	paramALTD = getParamA(NL_LTD + random.Normal(*gaussian_dist2)) * maxNumLevelLTD;	// Parameter A for LTD nonlinearity
+	DrawConductanceRangeVar(random);
+}
  
 double _2T1F::Read(double voltage) {
-	extern std::mt19937 gen;
 		if (readNoise) {
-			return voltage * conductance * (1 + (*gaussian_dist)(gen));
+			return voltage * conductance * (1 + ReadRandom().Normal(*gaussian_dist));
 		} else {
 			return voltage * conductance;
 		}
@@ -1414,9 +1395,8 @@ void _2T1F::Write(double deltaWeightNormalized, double weight, double minWeight,
 	}
 
 	// Cycle-to-cycle variation
-	extern std::mt19937 gen;
 	if (sigmaCtoC && numPulse != 0) {
-		conductanceNew += (*gaussian_dist3)(gen) * sqrt(abs(numPulse));	// Absolute variation
+		conductanceNew += WriteRandom().Normal(*gaussian_dist3) * sqrt(abs(numPulse));	// Absolute variation
 	}
 	
 	if (conductanceNew > maxConductance) {
@@ -41,13 +41,26 @@
 
 #include <random>
 #include <vector>
+#include "RNG.h"
 
 class Cell {
 public:
 	int x, y;	// Cell location: x (column) and y (row) start from index 0
 	double heightInFeatureSize, widthInFeatureSize;	// Cell height/width in terms of feature size (F)
 	double area;	// Cell area (m^2)
+	uint32_t randomStreamId;	// Id of the random streams of this cell (see RNG.h), set by Array::Initialization()
+	uint32_t numRandomWrites;	// # of writes that drew random numbers, so that consecutive writes use different streams
+	uint32_t numRandomReadbacks;	// # of reads outside the FF that drew random numbers (see RANDOM_STEP_READBACK)
+	Cell(): randomStreamId(0), numRandomWrites(0), numRandomReadbacks(0) {}
 	virtual ~Cell() {}	// Add a virtual function to enable dynamic_cast
+	virtual void SetRandomStream(uint32_t id) { randomStreamId = id; }
+	RandomStream ReadRandom() {	// Read noise of the current bit plane, or of this read-back
+		if (randomPhase.step < RANDOM_STEP_READBACK) {
+			return RandomStream(randomStreamId | RANDOM_READ, randomPhase.step);
+		}
+		return RandomStream(randomStreamId | RANDOM_READ, RANDOM_STEP_READBACK | (numRandomReadbacks++ & (RANDOM_STEP_READBACK - 1)));
+	}
+	RandomStream WriteRandom() { return RandomStream(randomStreamId | RANDOM_WRITE, numRandomWrites++); }	// Write noise
 };
 
 class eNVM: public Cell {
@@ -90,6 +103,8 @@ public:
 	bool conductanceRangeVar;	// Consider variation of conductance range or not
 	double maxConductanceVar;	// Sigma of maxConductance variation (S)
 	double minConductanceVar;	// Sigma of minConductance variation (S)
+
+	void DrawConductanceRangeVar(RandomStream &random);
 };
 
 class SRAM: public Cell {
@@ -153,6 +168,7 @@ public:
 class DigitalNVM: public eNVM {
 public:
 	DigitalNVM(int x, int y);
+	void SetRandomStream(uint32_t id);	// Also draws the device-to-device variation of the cell
 	int bit;	// Stored bit (1 or 0) (dynamic variable), for internel check only and not be used for read
 	int bitPrev;	// Previous bit
 	double refCurrent;	// Reference current for S/A
@@ -166,6 +182,7 @@ public:
 class IdealDevice: public AnalogNVM {
 public:
 	IdealDevice(int x, int y);
+	void SetRandomStream(uint32_t id);	// Also draws the device-to-device variation of the cell
 	double Read(double voltage);	// Return read current (A)
 	void Write(double deltaWeightNormalized, double weight, double minWeight, double maxWeight);
 };
@@ -184,6 +201,7 @@ public:
 	double sigmaCtoC;	// Sigma of cycle-to-cycle variation on weight update
 
 	RealDevice(int x, int y);
+	void SetRandomStream(uint32_t id);	// Also draws the device-to-device variation of the cell
 	double Read(double voltage);	// Return read current (A)
 	void Write(double deltaWeightNormalized, double weight, double minWeight, double maxWeight);
 	
@@ -274,6 +292,7 @@ class _3T1C : public Cell {
 	double minConductanceVar;	// Sigma of minConductance variation (S)
     
     _3T1C(int x, int y);
+    void SetRandomStream(uint32_t id);	// Also draws the device-to-device variation of the cell
 	double Read(double voltage) ;
 	void Write(double deltaWeightNormalized, double weight, double minWeight, double maxWeight);
 	double GetMaxReadCurrent(void);
@@ -307,6 +326,12 @@ public:
                 // the analog read out is for FeFET hybrid precision cell
   bool Digital; 
   HybridCell(int x, int y);
+  void SetRandomStream(uint32_t id) {
+    randomStreamId = id;
+    LSBcell.SetRandomStream(id | 1u << RANDOM_SUBCELL_SHIFT);
+    MSBcell_LTP.SetRandomStream(id | 2u << RANDOM_SUBCELL_SHIFT);
+    MSBcell_LTD.SetRandomStream(id | 3u << RANDOM_SUBCELL_SHIFT);
+  }
   double ReadCell(void) ;
   double ReadMSB(void);
   void Write(double deltaWeightNormalized, double weight, double minWeight, double maxWeight) ;
@@ -369,6 +394,7 @@ class _2T1F : public AnalogNVM{
                                                 // calculated during the weight transfer;
  
     _2T1F(int x, int y);
+    void SetRandomStream(uint32_t id);	// Also draws the device-to-device variation of the cell
   	double GetMaxReadCurrent() {return readVoltage * maxConductance;}
   	double GetMinReadCurrent() {return readVoltage * minConductance;}
   	double Read(double voltage) ;
@@ -0,0 +1,171 @@
+/*******************************************************************************
+* Copyright (c) 2015-2017
+* School of Electrical, Computer and Energy Engineering, Arizona State University
+* PI: Prof. Shimeng Yu
+* All rights reserved.
+*   
+* This source code is part of NeuroSim - a device-circuit-algorithm framework to benchmark 
+* neuro-inspired architectures with synaptic devices(e.g., SRAM and emerging non-volatile memory). 
+* Copyright of the model is maintained by the developers, and the model is distributed under 
+* the terms of the Creative Commons Attribution-NonCommercial 4.0 International Public License 
+* http://creativecommons.org/licenses/by-nc/4.0/legalcode.
+* The source code is free and you can redistribute and/or modify it
+* by providing that the following conditions are met:
+*   
+*  1) Redistributions of source code must retain the above copyright notice,
+*     this list of conditions and the following disclaimer. 
+*   
+*  2) Redistributions in binary form must reproduce the above copyright notice,
+*     this list of conditions and the following disclaimer in the documentation
+*     and/or other materials provided with the distribution.
+*   
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+* Developer list: 
+*   Pai-Yu Chen     Email: pchen72 at asu dot edu 
+*                     
+*   Xiaochen Peng   Email: xpeng15 at asu dot edu
+********************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#if defined(__AVX__)	// make SIMD=avx2 (see makefile)
+#include <immintrin.h>
+#endif
+#include "formula.h"
+#include "Param.h"
+#include "Array.h"
+#include "Mapping.h"
+#include "Crossbar.h"
+#include "NetworkShape.h"
+
+extern Param *param;
+
+/* Weighted sum currents of columns [0, numCols) when the given rows are selected, read from the cached cell read currents.
+   Isum accumulates the cell currents and refSum the currents of the reference (medium conductance) cells.
+   The array is row-major, so the columns are processed in blocks that stay in registers while walking down the active rows.
+   Each column still adds its rows in the order of activeRows, so the sums match the cell-by-cell ReadCell() loop exactly.
+   NumCols > 0 is the # of columns fixed at compile time, which unrolls the blocks and the remaining columns; 0 reads numCols */
+template <int NumCols>
+static void ReadColumnCurrentsOf(const Array *array, const unsigned short *activeRows, int numActiveRows, int numCols, double *Isum, double *refSum) {
+	if (NumCols > 0) {
+		numCols = NumCols;
+	}
+	const int blockCols = 16;	// 4 AVX registers of doubles per sum
+	const int stride = array->numCellCols;
+	const double *current = array->readCurrent;
+	const double *refCurrent = array->mediumReadCurrent;
+	int j0 = 0;
+	for (; j0 + blockCols <= numCols; j0 += blockCols) {
+#if defined(__AVX__)
+		__m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd(), s2 = _mm256_setzero_pd(), s3 = _mm256_setzero_pd();
+		__m256d r0 = _mm256_setzero_pd(), r1 = _mm256_setzero_pd(), r2 = _mm256_setzero_pd(), r3 = _mm256_setzero_pd();
+		for (int a=0; a<numActiveRows; a++) {
+			const double *I = current + (size_t)activeRows[a] * stride + j0;
+			const double *Iref = refCurrent + (size_t)activeRows[a] * stride + j0;
+			s0 = _mm256_add_pd(s0, _mm256_loadu_pd(I));
+			s1 = _mm256_add_pd(s1, _mm256_loadu_pd(I + 4));
+			s2 = _mm256_add_pd(s2, _mm256_loadu_pd(I + 8));
+			s3 = _mm256_add_pd(s3, _mm256_loadu_pd(I + 12));
+			r0 = _mm256_add_pd(r0, _mm256_loadu_pd(Iref));
+			r1 = _mm256_add_pd(r1, _mm256_loadu_pd(Iref + 4));
+			r2 = _mm256_add_pd(r2, _mm256_loadu_pd(Iref + 8));
+			r3 = _mm256_add_pd(r3, _mm256_loadu_pd(Iref + 12));
+		}
+		_mm256_storeu_pd(Isum + j0, s0);
+		_mm256_storeu_pd(Isum + j0 + 4, s1);
+		_mm256_storeu_pd(Isum + j0 + 8, s2);
+		_mm256_storeu_pd(Isum + j0 + 12, s3);
+		_mm256_storeu_pd(refSum + j0, r0);
+		_mm256_storeu_pd(refSum + j0 + 4, r1);
+		_mm256_storeu_pd(refSum + j0 + 8, r2);
+		_mm256_storeu_pd(refSum + j0 + 12, r3);
+#else
+		/* Portable version of the same block, vectorized by the compiler */
+		double s[blockCols] = {0}, r[blockCols] = {0};
+		for (int a=0; a<numActiveRows; a++) {
+			const double *I = current + (size_t)activeRows[a] * stride + j0;
+			const double *Iref = refCurrent + (size_t)activeRows[a] * stride + j0;
+			for (int c=0; c<blockCols; c++) {
+				s[c] += I[c];
+				r[c] += Iref[c];
+			}
+		}
+		std::copy(s, s + blockCols, Isum + j0);
+		std::copy(r, r + blockCols, refSum + j0);
+#endif
+	}
+	/* Remaining columns */
+	std::fill(Isum + j0, Isum + numCols, 0);
+	std::fill(refSum + j0, refSum + numCols, 0);
+	for (int a=0; a<numActiveRows; a++) {
+		const double *I = current + (size_t)activeRows[a] * stride;
+		const double *Iref = refCurrent + (size_t)activeRows[a] * stride;
+		for (int j=j0; j<numCols; j++) {
+			Isum[j] += I[j];
+			refSum[j] += Iref[j];
+		}
+	}
+}
+
+/* Hardware forward pass of one layer on an analog eNVM array with cached read currents (Array::cachedReadCurrent).
+   activeRows[n] lists the numActiveRows[n] rows whose nth input bit is 1. For every column this accumulates the
+   digitized partial sums of all bit planes into outN, then a = sigmoid(outN) and, if da is not NULL, the digitized
+   output for the next layer. The array read energy (except the WL gate energy) is added to sumArrayReadEnergy.
+   NumCols is as in ReadColumnCurrentsOf(); a fixed # of columns keeps the sums in aligned fixed-size arrays */
+template <int NumCols>
+static void AnalogLayerForwardOf(const Array *array, int numCols, const unsigned short *const *activeRows, const int *numActiveRows, double *outN, double *a, int *da, double &sumArrayReadEnergy) {
+	if (NumCols > 0) {
+		numCols = NumCols;
+	}
+	double readVoltage = static_cast<eNVM*>(array->cell[0][0])->readVoltage;
+	double readPulseWidth = static_cast<eNVM*>(array->cell[0][0])->readPulseWidth;
+	alignas(64) double Isum[NumCols > 0? NumCols : numCols];   // weighted sum current
+	alignas(64) double refSum[NumCols > 0? NumCols : numCols]; // Weighted sum current of input vector * weight=1 column
+
+	for (int n=0; n<param->numBitInput; n++) {
+		double pSumMaxAlgorithm = pow(2, n) / (param->numInputLevel - 1) * array->arrayRowSize;  // Max algorithm partial weighted sum for the nth vector bit (if both max input value and max weight are 1)
+		ReadColumnCurrentsOf<NumCols>(array, activeRows[n], numActiveRows[n], numCols, Isum, refSum);
+		sumArrayReadEnergy += array->wireCapRow * readVoltage * readVoltage * numActiveRows[n] * numCols; // Selected BLs (1T1R) or Selected WLs (cross-point)
+		for (int j=0; j<numCols; j++) {
+			double IsumRange = array->columnMaxReadCurrent[j] - array->columnMinReadCurrent[j];
+			sumArrayReadEnergy += Isum[j] * readVoltage * readPulseWidth;
+			int outputDigits = CurrentToDigits(Isum[j], IsumRange) - CurrentToDigits(refSum[j], IsumRange);
+			outN[j] += DigitsToAlgorithm(outputDigits, pSumMaxAlgorithm);
+		}
+	}
+	for (int j=0; j<numCols; j++) {
+		a[j] = sigmoid(outN[j]);
+		if (da) {
+			da[j] = round_th(a[j]*(param->numInputLevel-1), param->Hthreshold);
+		}
+	}
+}
+
+void ReadColumnCurrents(const Array *array, const unsigned short *activeRows, int numActiveRows, int numCols, double *Isum, double *refSum) {
+	ReadColumnCurrentsOf<0>(array, activeRows, numActiveRows, numCols, Isum, refSum);
+}
+
+/* The layers of a fixed network shape (NetworkShape.h) take the kernels of their # of columns */
+void AnalogLayerForward(const Array *array, int numCols, const unsigned short *const *activeRows, const int *numActiveRows, double *outN, double *a, int *da, double &sumArrayReadEnergy) {
+#if defined(NETWORK_SHAPE)
+	if (numCols == TrainNetworkShape::nHide) {
+		AnalogLayerForwardOf<TrainNetworkShape::nHide>(array, numCols, activeRows, numActiveRows, outN, a, da, sumArrayReadEnergy);
+		return;
+	}
+	if (numCols == TrainNetworkShape::nOutput) {
+		AnalogLayerForwardOf<TrainNetworkShape::nOutput>(array, numCols, activeRows, numActiveRows, outN, a, da, sumArrayReadEnergy);
+		return;
+	}
+#endif
+	AnalogLayerForwardOf<0>(array, numCols, activeRows, numActiveRows, outN, a, da, sumArrayReadEnergy);
+}
@@ -0,0 +1,124 @@
+/*******************************************************************************
+* Copyright (c) 2015-2017
+* School of Electrical, Computer and Energy Engineering, Arizona State University
+* PI: Prof. Shimeng Yu
+* All rights reserved.
+*   
+* This source code is part of NeuroSim - a device-circuit-algorithm framework to benchmark 
+* neuro-inspired architectures with synaptic devices(e.g., SRAM and emerging non-volatile memory). 
+* Copyright of the model is maintained by the developers, and the model is distributed under 
+* the terms of the Creative Commons Attribution-NonCommercial 4.0 International Public License 
+* http://creativecommons.org/licenses/by-nc/4.0/legalcode.
+* The source code is free and you can redistribute and/or modify it
+* by providing that the following conditions are met:
+*   
+*  1) Redistributions of source code must retain the above copyright notice,
+*     this list of conditions and the following disclaimer. 
+*   
+*  2) Redistributions in binary form must reproduce the above copyright notice,
+*     this list of conditions and the following disclaimer in the documentation
+*     and/or other materials provided with the distribution.
+*   
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+* Developer list: 
+*   Pai-Yu Chen     Email: pchen72 at asu dot edu 
+*                     
+*   Xiaochen Peng   Email: xpeng15 at asu dot edu
+********************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sys/mman.h>
+#include "Dataset.h"
+
+Dataset::Dataset(int numImages, int nInput, int nOutput, int numInputLevel) {
+	this->numImages = numImages;
+	this->nInput = nInput;
+	this->nOutput = nOutput;
+	this->numInputLevel = numInputLevel;
+	if (numInputLevel > 256 || nOutput > 256) {
+		std::cout << "numInputLevel=" << numInputLevel << " or nOutput=" << nOutput << " does not fit in one byte\n";
+		exit(-1);
+	}
+	for (int l = 0; l < 256; l++) {
+		inputOfLevel[l] = (numInputLevel > 1)? (double)l / (numInputLevel - 1) : l;
+	}
+	levelStorage.resize((size_t)numImages * nInput);
+	labelStorage.resize(numImages);
+	level = levelStorage.data();
+	label = labelStorage.data();
+	mappedAddr = NULL;
+	mappedSize = 0;
+	numBitInput = 0;
+}
+
+Dataset::~Dataset() {
+	if (mappedAddr) {
+		munmap(mappedAddr, mappedSize);
+	}
+}
+
+/* Point the accessors to a mapping of the binary dataset file and release the owned storage */
+void Dataset::UseMapping(void *addr, size_t size, const unsigned char *level, const unsigned char *label) {
+	if (mappedAddr) {
+		munmap(mappedAddr, mappedSize);
+	}
+	mappedAddr = addr;
+	mappedSize = size;
+	this->level = level;
+	this->label = label;
+	std::vector<unsigned char>().swap(levelStorage);
+	std::vector<unsigned char>().swap(labelStorage);
+}
+
+/* Build the per-image, per-bit-plane lists of active rows once the digitized inputs are loaded */
+void Dataset::BuildActiveRowIndex(int numBitInput) {
+	if (nInput > 65536) {
+		std::cout << "nInput=" << nInput << " is too large for the active row index\n";
+		exit(-1);
+	}
+	this->numBitInput = numBitInput;
+	size_t numLists = (size_t)numImages * numBitInput;
+	activeRowPtr.assign(numLists + 1, 0);
+
+	/* Count the active rows of each list, then turn the counts into offsets */
+	#pragma omp parallel for
+	for (int i=0; i<numImages; i++) {
+		const unsigned char *levelRow = GetLevelRow(i);
+		for (int n=0; n<numBitInput; n++) {
+			size_t count = 0;
+			for (int k=0; k<nInput; k++) {
+				count += (levelRow[k]>>n) & 1;
+			}
+			activeRowPtr[(size_t)i * numBitInput + n + 1] = count;
+		}
+	}
+	for (size_t l=0; l<numLists; l++) {
+		activeRowPtr[l+1] += activeRowPtr[l];
+	}
+
+	activeRow.resize(activeRowPtr[numLists]);
+	#pragma omp parallel for
+	for (int i=0; i<numImages; i++) {
+		const unsigned char *levelRow = GetLevelRow(i);
+		for (int n=0; n<numBitInput; n++) {
+			unsigned short *rowOfBit = activeRow.data() + activeRowPtr[(size_t)i * numBitInput + n];
+			for (int k=0; k<nInput; k++) {
+				if ((levelRow[k]>>n) & 1) {
+					*rowOfBit++ = k;
+				}
+			}
+		}
+	}
+}
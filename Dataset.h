@@ -0,0 +1,123 @@
+/*******************************************************************************
+* Copyright (c) 2015-2017
+* School of Electrical, Computer and Energy Engineering, Arizona State University
+* PI: Prof. Shimeng Yu
+* All rights reserved.
+*   
+* This source code is part of NeuroSim - a device-circuit-algorithm framework to benchmark 
+* neuro-inspired architectures with synaptic devices(e.g., SRAM and emerging non-volatile memory). 
+* Copyright of the model is maintained by the developers, and the model is distributed under 
+* the terms of the Creative Commons Attribution-NonCommercial 4.0 International Public License 
+* http://creativecommons.org/licenses/by-nc/4.0/legalcode.
+* The source code is free and you can redistribute and/or modify it
+* by providing that the following conditions are met:
+*   
+*  1) Redistributions of source code must retain the above copyright notice,
+*     this list of conditions and the following disclaimer. 
+*   
+*  2) Redistributions in binary form must reproduce the above copyright notice,
+*     this list of conditions and the following disclaimer in the documentation
+*     and/or other materials provided with the distribution.
+*   
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+* Developer list: 
+*   Pai-Yu Chen     Email: pchen72 at asu dot edu 
+*                     
+*   Xiaochen Peng   Email: xpeng15 at asu dot edu
+********************************************************************************/
+
+#ifndef DATASET_H_
+#define DATASET_H_
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+/* Active rows (the nth bit of the digitized input is 1) of one input vector for each bit plane, rebuilt at runtime */
+class ActiveRowList {
+public:
+	int numRows;		// # of rows (length of the input vector)
+	int numBitInput;	// # of bit planes
+	std::vector<unsigned short> row;	// Active row indices of each bit plane, numBitInput x numRows
+	std::vector<int> numActive;			// # of active rows of each bit plane
+	int totalActive;	// # of active rows summed over all bit planes
+
+	ActiveRowList(int numRows, int numBitInput): numRows(numRows), numBitInput(numBitInput),
+		row((size_t)numRows * numBitInput), numActive(numBitInput), totalActive(0) {
+		if (numRows > 65536) {	// The rows are stored as unsigned short
+			printf("[Error] numRows=%d is too large for the active row list\n", numRows);
+			exit(-1);
+		}
+	}
+
+	void Build(const int *dInput) {
+		totalActive = 0;
+		for (int n=0; n<numBitInput; n++) {
+			unsigned short *rowOfBit = row.data() + (size_t)n * numRows;
+			int count = 0;
+			for (int k=0; k<numRows; k++) {
+				if ((dInput[k]>>n) & 1) {
+					rowOfBit[count++] = k;
+				}
+			}
+			numActive[n] = count;
+			totalActive += count;
+		}
+	}
+	const unsigned short *GetActiveRows(int n) const { return row.data() + (size_t)n * numRows; }
+	int GetNumActiveRows(int n) const { return numActive[n]; }
+	int GetNumActiveRows() const { return totalActive; }
+};
+
+/* Compact storage of an image dataset: one byte per digitized pixel and one byte per label.
+   The bytes either live in this object (text files) or in a read-only shared mapping of the binary dataset file. */
+class Dataset {
+public:
+	int numImages;		// # of images
+	int nInput;			// # of pixels per image
+	int nOutput;		// # of label classes
+	int numInputLevel;	// # of levels used to digitize the inputs
+	const unsigned char *level;	// Digitized inputs (an integer between 0 to numInputLevel-1), numImages x nInput, image-major
+	const unsigned char *label;	// Label of each image (an integer between 0 to nOutput-1)
+	double inputOfLevel[256];	// Analog input value of each digitized level (same value as truncate())
+	std::vector<unsigned char> levelStorage;	// Owned storage (empty when the data is mapped)
+	std::vector<unsigned char> labelStorage;
+	void *mappedAddr;	// Mapping of the binary dataset file (NULL when the data is owned)
+	size_t mappedSize;
+	/* Active row index (CSR): the active rows of image i for the nth bit plane are
+	   activeRow[activeRowPtr[i*numBitInput+n]] to activeRow[activeRowPtr[i*numBitInput+n+1]-1], in ascending order */
+	int numBitInput;
+	std::vector<size_t> activeRowPtr;
+	std::vector<unsigned short> activeRow;
+
+	Dataset(int numImages, int nInput, int nOutput, int numInputLevel);
+	~Dataset();
+	void UseMapping(void *addr, size_t size, const unsigned char *level, const unsigned char *label);
+	void BuildActiveRowIndex(int numBitInput);
+
+	/* Accessors (i: image, k: pixel, j: output neuron) */
+	int GetLevel(int i, int k) const { return level[(size_t)i * nInput + k]; }	// Digitized input
+	double GetInput(int i, int k) const { return inputOfLevel[level[(size_t)i * nInput + k]]; }	// Input between 0 and 1
+	int GetLabel(int i) const { return label[i]; }
+	double GetOutput(int i, int j) const { return (label[i] == j) ? 1 : 0; }	// One-hot target output
+	const unsigned char *GetLevelRow(int i) const { return level + (size_t)i * nInput; }
+	const unsigned short *GetActiveRows(int i, int n) const { return activeRow.data() + activeRowPtr[(size_t)i * numBitInput + n]; }
+	int GetNumActiveRows(int i, int n) const { return activeRowPtr[(size_t)i * numBitInput + n + 1] - activeRowPtr[(size_t)i * numBitInput + n]; }
+	int GetNumActiveRows(int i) const { return activeRowPtr[(size_t)(i + 1) * numBitInput] - activeRowPtr[(size_t)i * numBitInput]; }	// Summed over all bit planes
+
+	void SetLevel(int i, int k, int value) { levelStorage[(size_t)i * nInput + k] = value; }
+	void SetLabel(int i, int value) { labelStorage[i] = value; }
+};
+
+#endif
@@ -41,12 +41,10 @@
 /* Global variables */
 Param *param = new Param(); // Parameter set
 
-/* Inputs of training set */
-std::vector< std::vector<double> >
-Input(param->numMnistTrainImages, std::vector<double>(param->nInput));
-/* Outputs of training set */
-std::vector< std::vector<double> >
-Output(param->numMnistTrainImages, std::vector<double>(param->nOutput));
+/* Training set (digitized inputs and labels, one byte each) */
+Dataset *trainSet = new Dataset(param->numMnistTrainImages, param->nInput, param->nOutput, param->numInputLevel);
+/* Testing set (digitized inputs and labels, one byte each) */
+Dataset *testSet = new Dataset(param->numMnistTestImages, param->nInput, param->nOutput, param->numInputLevel);
 
 /* Weights from input to hidden layer */
 std::vector< std::vector<double> >
@@ -74,45 +72,26 @@ totalDeltaWeight2(param->nOutput, std::vector<double>(param->nHide));
 std::vector< std::vector<double> >
 totalDeltaWeight2_abs(param->nOutput, std::vector<double>(param->nHide));
 
-/* Inputs of testing set */
-std::vector< std::vector<double> >
-testInput(param->numMnistTestImages, std::vector<double>(param->nInput));
-/* Outputs of testing set */
-std::vector< std::vector<double> >
-testOutput(param->numMnistTestImages, std::vector<double>(param->nOutput));
-
-/* Digitized inputs of training set (an integer between 0 to 2^numBitInput-1) */
-std::vector< std::vector<int> >
-dInput(param->numMnistTrainImages, std::vector<int>(param->nInput));
-/* Digitized inputs of testing set (an integer between 0 to 2^numBitInput-1) */
-std::vector< std::vector<int> >
-dTestInput(param->numMnistTestImages, std::vector<int>(param->nInput));
-
-// the arrays for optimization
-std::vector< std::vector<double> > 
-gradSquarePrev1(param->nHide, std::vector<double>(param->nInput));
-std::vector< std::vector<double> >
-gradSquarePrev2(param->nOutput, std::vector<double>(param->nHide));
-std::vector< std::vector<double> > 
-gradSum1(param->nHide, std::vector<double>(param->nInput));
-std::vector< std::vector<double> >
-gradSum2(param->nOutput, std::vector<double>(param->nHide));
-std::vector< std::vector<double> >
-momentumPrev1(param->nHide, std::vector<double>(param->nInput));
-std::vector< std::vector<double> >
-momentumPrev2(param->nOutput, std::vector<double>(param->nHide));
+/* Optimizers of the weights of each layer (with their state) */
+Optimizer *optimizerIH = CreateOptimizer(param->optimization_type, param->nInput, param->nHide, param->alpha1, param->numTrainImagesPerBatch);
+Optimizer *optimizerHO = CreateOptimizer(param->optimization_type, param->nHide, param->nOutput, param->alpha2, param->numTrainImagesPerBatch);
 
+/* Training processes and their shared-memory all-reduce (the slots fit the pulse counts or gradients of the larger layer) */
+ReplicaGroup *replicas = new ReplicaGroup(param->numReplicas, std::max(param->nInput * param->nHide, param->nHide * param->nOutput));
 
 /* # of correct prediction */
 int correct = 0;
 
+/* Wall time of a training sample, averaged over the last call of Train() */
+double trainTimePerSample = 0;
+
 /* Synaptic array between input and hidden layer */
-Array *arrayIH = new Array(param->nHide, param->nInput, param->arrayWireWidth);
+Array *arrayIH = new Array(param->nHide, param->nInput, param->arrayWireWidth, 0);
 /* Synaptic array between hidden and output layer */
-Array *arrayHO = new Array(param->nOutput, param->nHide, param->arrayWireWidth);
+Array *arrayHO = new Array(param->nOutput, param->nHide, param->arrayWireWidth, 1);
 
-/* Random number generator engine */
-std::mt19937 gen;
+/* Key of the counter-based random streams (see RNG.h) */
+RandomPhase randomPhase;
 
 /* NeuroSim */
 SubArray *subArrayIH;   // NeuroSim synaptic core for arrayIH
@@ -38,23 +38,26 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <cmath>
 #include <iostream>
 #include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "formula.h"
 #include "Param.h"
 #include "Cell.h"
 #include "Array.h"
+#include "Dataset.h"
+#include "IO.h"
 
 extern Param *param;
 extern Array *arrayIH;
 extern Array *arrayHO;
-extern std::vector< std::vector<double> > Input;
-extern std::vector< std::vector<int> > dInput;
-extern std::vector< std::vector<double> > testInput;
-extern std::vector< std::vector<int> > dTestInput;
-extern std::vector< std::vector<double> > Output;
-extern std::vector< std::vector<double> > testOutput;
+extern Dataset *trainSet;
+extern Dataset *testSet;
 
 extern std::vector< std::vector<double> > weight1;
 extern std::vector< std::vector<double> > weight2;
@@ -81,9 +84,10 @@ void ReadTrainingDataFromFile(const char *trainPatchFileName, const char *trainL
 
 	int i = 0;
 	int j = 0;
-	while (fscanf(fp_patch, "%lf", &Input[i][j]) != EOF){
-		Input[i][j] = truncate(Input[i][j], param->numInputLevel - 1, param->BWthreshold);
-		dInput[i][j] = round(Input[i][j] * (param->numInputLevel - 1));
+	double input;
+	while (fscanf(fp_patch, "%lf", &input) != EOF){
+		input = truncate(input, param->numInputLevel - 1, param->BWthreshold);
+		trainSet->SetLevel(i, j, round(input * (param->numInputLevel - 1)));
 		i += 1;
 		if (i%param->numMnistTrainImages == 0){
 			j += 1;
@@ -95,9 +99,10 @@ void ReadTrainingDataFromFile(const char *trainPatchFileName, const char *trainL
 	j = 0;
 	int k = 0;
 	while (fscanf(fp_label, "%d", &k) != EOF){
-		Output[i][k] = 1;
+		trainSet->SetLabel(i, k);
 		i += 1;
 	}
+	trainSet->BuildActiveRowIndex(param->numBitInput);
 	fclose(fp_patch);
 	fclose(fp_label);
 }
@@ -118,9 +123,10 @@ void ReadTestingDataFromFile(const char *testPatchFileName, const char *testLabe
 
 	int i = 0;
 	int j = 0;
-	while (fscanf(fp_patch, "%lf", &testInput[i][j]) != EOF){
-		testInput[i][j] = truncate(testInput[i][j], param->numInputLevel - 1, param->BWthreshold);
-		dTestInput[i][j] = round(testInput[i][j] * (param->numInputLevel - 1));
+	double input;
+	while (fscanf(fp_patch, "%lf", &input) != EOF){
+		input = truncate(input, param->numInputLevel - 1, param->BWthreshold);
+		testSet->SetLevel(i, j, round(input * (param->numInputLevel - 1)));
 		i += 1;
 		if (i%param->numMnistTestImages == 0){
 			j += 1;
@@ -131,14 +137,138 @@ void ReadTestingDataFromFile(const char *testPatchFileName, const char *testLabe
 	j = 0;
 	int k = 0;
 	while (fscanf(fp_label, "%d", &k) != EOF){
-		testOutput[i][k] = 1;
+		testSet->SetLabel(i, k);
 		i += 1;
 	}
+	testSet->BuildActiveRowIndex(param->numBitInput);
 
 	fclose(fp_patch);
 	fclose(fp_label);
 }
 
+/* Size and modification time of a source text file (both -1 if it cannot be found) */
+static void StatSourceFile(const char *fileName, long long *size, long long *time) {
+	struct stat st;
+	if (stat(fileName, &st) != 0) {
+		*size = -1;
+		*time = -1;
+		return;
+	}
+	*size = st.st_size;
+	*time = st.st_mtime;
+}
+
+/* Map a binary dataset file and let the dataset read its digitized inputs and labels in place */
+static bool ReadDataFromBinary(const char *binaryFileName, const char *patchFileName, const char *labelFileName, Dataset *dataset) {
+	int numImages = dataset->numImages;
+	int fd = open(binaryFileName, O_RDONLY);
+	if (fd < 0) {
+		return false;	// Not converted yet
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(DatasetFileHeader)) {
+		close(fd);
+		return false;
+	}
+	/* Map the file read-only and shared, so that concurrent simulations use the same physical pages */
+	void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) {
+		return false;
+	}
+	const char *base = (const char *)addr;
+	DatasetFileHeader header;
+	memcpy(&header, base, sizeof(header));
+
+	/* The file is only valid for the same dataset size and the same input digitization */
+	bool valid = (memcmp(header.magic, DATASET_FILE_MAGIC, sizeof(header.magic)) == 0)
+				&& header.version == DATASET_FILE_VERSION
+				&& header.numImages == numImages
+				&& header.nInput == param->nInput
+				&& header.nOutput == param->nOutput
+				&& header.numInputLevel == param->numInputLevel
+				&& header.BWthreshold == param->BWthreshold
+				&& header.inputOffset + (long long)numImages * param->nInput <= st.st_size
+				&& header.labelOffset + numImages <= st.st_size;
+
+	/* The file is also stale if the text files it was converted from have changed since
+	   (it is kept as it is if the text files are no longer there, since it cannot be regenerated anyway) */
+	long long patchFileSize, patchFileTime, labelFileSize, labelFileTime;
+	StatSourceFile(patchFileName, &patchFileSize, &patchFileTime);
+	StatSourceFile(labelFileName, &labelFileSize, &labelFileTime);
+	if (patchFileSize >= 0 && labelFileSize >= 0) {
+		valid = valid && header.patchFileSize == patchFileSize && header.patchFileTime == patchFileTime
+					&& header.labelFileSize == labelFileSize && header.labelFileTime == labelFileTime;
+	}
+	if (!valid) {
+		std::cout << binaryFileName << " does not match the current dataset parameters or text files and will be regenerated\n";
+		munmap(addr, st.st_size);
+		return false;
+	}
+
+	/* The mapping is kept for the whole run, so the dataset does not need its own copy */
+	dataset->UseMapping(addr, st.st_size, (const unsigned char *)(base + header.inputOffset),
+						(const unsigned char *)(base + header.labelOffset));
+	dataset->BuildActiveRowIndex(param->numBitInput);
+	return true;
+}
+
+/* Write the digitized inputs and the labels to a binary dataset file */
+static void WriteDataToBinary(const char *binaryFileName, const char *patchFileName, const char *labelFileName, const Dataset *dataset) {
+	int numImages = dataset->numImages;
+	DatasetFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, DATASET_FILE_MAGIC, sizeof(header.magic));
+	header.version = DATASET_FILE_VERSION;
+	header.numImages = numImages;
+	header.nInput = param->nInput;
+	header.nOutput = param->nOutput;
+	header.numInputLevel = param->numInputLevel;
+	header.BWthreshold = param->BWthreshold;
+	header.inputOffset = sizeof(header);
+	header.labelOffset = header.inputOffset + (long long)numImages * param->nInput;
+	StatSourceFile(patchFileName, &header.patchFileSize, &header.patchFileTime);
+	StatSourceFile(labelFileName, &header.labelFileSize, &header.labelFileTime);
+
+	/* Write to a temporary file first so that a concurrent simulation never maps a partial file */
+	char tempFileName[256];
+	snprintf(tempFileName, sizeof(tempFileName), "%s.%d.tmp", binaryFileName, (int)getpid());
+	FILE *fp = fopen(tempFileName, "wb");
+	if (!fp) {
+		std::cout << tempFileName << " cannot be created!\n";
+		return;
+	}
+	size_t numLevels = (size_t)numImages * param->nInput;
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1
+			&& fwrite(dataset->level, 1, numLevels, fp) == numLevels
+			&& fwrite(dataset->label, 1, numImages, fp) == (size_t)numImages;
+	ok = (fclose(fp) == 0) && ok;
+	if (!ok || rename(tempFileName, binaryFileName) != 0) {
+		std::cout << binaryFileName << " cannot be written!\n";
+		remove(tempFileName);
+	}
+}
+
+/* Read training data from the binary file (return false if it does not exist, does not match the parameters or is older than the text files) */
+bool ReadTrainingDataFromBinary(const char *trainBinaryFileName, const char *trainPatchFileName, const char *trainLabelFileName) {
+	return ReadDataFromBinary(trainBinaryFileName, trainPatchFileName, trainLabelFileName, trainSet);
+}
+
+/* Read testing data from the binary file (return false if it does not exist, does not match the parameters or is older than the text files) */
+bool ReadTestingDataFromBinary(const char *testBinaryFileName, const char *testPatchFileName, const char *testLabelFileName) {
+	return ReadDataFromBinary(testBinaryFileName, testPatchFileName, testLabelFileName, testSet);
+}
+
+/* Convert the training data read from the text files to the binary file */
+void WriteTrainingDataToBinary(const char *trainBinaryFileName, const char *trainPatchFileName, const char *trainLabelFileName) {
+	WriteDataToBinary(trainBinaryFileName, trainPatchFileName, trainLabelFileName, trainSet);
+}
+
+/* Convert the testing data read from the text files to the binary file */
+void WriteTestingDataToBinary(const char *testBinaryFileName, const char *testPatchFileName, const char *testLabelFileName) {
+	WriteDataToBinary(testBinaryFileName, testPatchFileName, testLabelFileName, testSet);
+}
+
 /* Print weight to file */
 void PrintWeightToFile(const char *str) {
 	/* Print weight1 */
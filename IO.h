@@ -39,8 +39,32 @@
 #ifndef IO_H_
 #define IO_H_
 
+#define DATASET_FILE_MAGIC "NSIMDATA"
+#define DATASET_FILE_VERSION 2
+
+/* Header of the binary dataset file (converted once from the patch/label text files) */
+struct DatasetFileHeader {
+	char magic[8];		// DATASET_FILE_MAGIC
+	int version;		// DATASET_FILE_VERSION
+	int numImages;		// # of images in the file
+	int nInput;			// # of pixels per image
+	int nOutput;		// # of label classes
+	int numInputLevel;	// # of levels used to digitize the inputs
+	double BWthreshold;	// The black and white threshold used to digitize the inputs
+	long long inputOffset;	// Byte offset of the digitized inputs (numImages x nInput, 1 byte each, image-major)
+	long long labelOffset;	// Byte offset of the labels (numImages, 1 byte each)
+	long long patchFileSize;	// Size of the patch text file the inputs were converted from
+	long long patchFileTime;	// Modification time of the patch text file
+	long long labelFileSize;	// Size of the label text file the labels were converted from
+	long long labelFileTime;	// Modification time of the label text file
+};
+
 void ReadTrainingDataFromFile(const char *trainPatchFileName, const char *trainLabelFileName);
 void ReadTestingDataFromFile(const char *testPatchFileName, const char *testLabelFileName);
+bool ReadTrainingDataFromBinary(const char *trainBinaryFileName, const char *trainPatchFileName, const char *trainLabelFileName);
+bool ReadTestingDataFromBinary(const char *testBinaryFileName, const char *testPatchFileName, const char *testLabelFileName);
+void WriteTrainingDataToBinary(const char *trainBinaryFileName, const char *trainPatchFileName, const char *trainLabelFileName);
+void WriteTestingDataToBinary(const char *testBinaryFileName, const char *testPatchFileName, const char *testLabelFileName);
 void PrintWeightToFile(const char *str);
 
 #endif
@@ -0,0 +1,78 @@
+/*******************************************************************************
+* Copyright (c) 2015-2017
+* School of Electrical, Computer and Energy Engineering, Arizona State University
+* PI: Prof. Shimeng Yu
+* All rights reserved.
+*   
+* This source code is part of NeuroSim - a device-circuit-algorithm framework to benchmark 
+* neuro-inspired architectures with synaptic devices(e.g., SRAM and emerging non-volatile memory). 
+* Copyright of the model is maintained by the developers, and the model is distributed under 
+* the terms of the Creative Commons Attribution-NonCommercial 4.0 International Public License 
+* http://creativecommons.org/licenses/by-nc/4.0/legalcode.
+* The source code is free and you can redistribute and/or modify it
+* by providing that the following conditions are met:
+*   
+*  1) Redistributions of source code must retain the above copyright notice,
+*     this list of conditions and the following disclaimer. 
+*   
+*  2) Redistributions in binary form must reproduce the above copyright notice,
+*     this list of conditions and the following disclaimer in the documentation
+*     and/or other materials provided with the distribution.
+*   
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+* Developer list: 
+*   Pai-Yu Chen     Email: pchen72 at asu dot edu 
+*                     
+*   Xiaochen Peng   Email: xpeng15 at asu dot edu
+********************************************************************************/
+
+#ifndef LEDGER_H_
+#define LEDGER_H_
+
+/* Write energy, latency and pulse counters of one row of a layer's WU. The rows of the WU loop run on different threads, so each
+   row keeps its own ledger on its own cache line instead of updating shared counters, and the layer adds the ledgers in row order
+   after the loop. The NeuroSim write energy of the rows, whose functions update the members of the SubArray, is computed in that
+   serial pass instead of in a critical section, and the pass also merges the half-selected column sums of the array that the
+   cross-point write energy of a row reads (see Array::DeferColumnHalfVw()). The totals are then the same for any # of threads.
+   The ledgers are allocated from a Workspace (64-byte aligned) and are not initialized, so every row calls Clear() first. */
+class alignas(64) WriteLedger {
+public:
+	double arrayWriteEnergy;		// Added to array->writeEnergy
+	double neuroSimWriteEnergy;		// Added to subArray->writeDynamicEnergy
+	double writeLatencyAnalogNVM;	// Latency of the batch writes of analog eNVM
+	double weightUpdate;			// Added to totalWeightUpdate
+	double numPulse;				// Added to totalNumPulse
+	double writeVoltage;			// subArray->cell.writeVoltage of this row (< 0: not set)
+	int numWriteOperation;			// # of write batches with any weight change
+	int numWritePulse;				// subArray->numWritePulse of this row (< 0: not set)
+	bool written;					// The row ran the WU loop
+
+	void Clear() {
+		arrayWriteEnergy = neuroSimWriteEnergy = writeLatencyAnalogNVM = 0;
+		weightUpdate = numPulse = 0;
+		writeVoltage = -1;
+		numWriteOperation = 0;
+		numWritePulse = -1;
+		written = false;
+	}
+	void Add(const WriteLedger &row) {
+		arrayWriteEnergy += row.arrayWriteEnergy;
+		neuroSimWriteEnergy += row.neuroSimWriteEnergy;
+		writeLatencyAnalogNVM += row.writeLatencyAnalogNVM;
+		weightUpdate += row.weightUpdate;
+		numPulse += row.numPulse;
+		numWriteOperation += row.numWriteOperation;
+	}
+};
+
+#endif
@@ -0,0 +1,84 @@
+/*******************************************************************************
+* Copyright (c) 2015-2017
+* School of Electrical, Computer and Energy Engineering, Arizona State University
+* PI: Prof. Shimeng Yu
+* All rights reserved.
+*   
+* This source code is part of NeuroSim - a device-circuit-algorithm framework to benchmark 
+* neuro-inspired architectures with synaptic devices(e.g., SRAM and emerging non-volatile memory). 
+* Copyright of the model is maintained by the developers, and the model is distributed under 
+* the terms of the Creative Commons Attribution-NonCommercial 4.0 International Public License 
+* http://creativecommons.org/licenses/by-nc/4.0/legalcode.
+* The source code is free and you can redistribute and/or modify it
+* by providing that the following conditions are met:
+*   
+*  1) Redistributions of source code must retain the above copyright notice,
+*     this list of conditions and the following disclaimer. 
+*   
+*  2) Redistributions in binary form must reproduce the above copyright notice,
+*     this list of conditions and the following disclaimer in the documentation
+*     and/or other materials provided with the distribution.
+*   
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+* Developer list: 
+*   Pai-Yu Chen     Email: pchen72 at asu dot edu 
+*                     
+*   Xiaochen Peng   Email: xpeng15 at asu dot edu
+********************************************************************************/
+
+#ifndef NETWORKSHAPE_H_
+#define NETWORKSHAPE_H_
+
+#include "Param.h"
+
+/* Layer sizes of the network. NetworkShape<nInput, nHide, nOutput> fixes them at compile time, so the loops of the training
+   kernels over them have constant bounds (the 10-wide output layer is unrolled and kept in registers). NetworkShape<0, 0, 0>
+   takes them from param at run time. The kernels read the sizes from a shape object, so the same code serves both */
+template <int NInput, int NHide, int NOutput>
+class NetworkShape {
+public:
+	static const int nInput = NInput;	// # of neurons in input layer
+	static const int nHide = NHide;		// # of neurons in hidden layer
+	static const int nOutput = NOutput;	// # of neurons in output layer
+	static const bool fixed = true;
+	static_assert(NInput > 0 && NHide > 0 && NOutput > 0, "A fixed network shape needs all three layer sizes");
+
+	NetworkShape(const Param */*param*/) {}
+	static bool Matches(const Param *param) {
+		return param->nInput == NInput && param->nHide == NHide && param->nOutput == NOutput;
+	}
+};
+
+template <>
+class NetworkShape<0, 0, 0> {
+public:
+	const int nInput;
+	const int nHide;
+	const int nOutput;
+	static const bool fixed = false;
+
+	NetworkShape(const Param *param): nInput(param->nInput), nHide(param->nHide), nOutput(param->nOutput) {}
+	static bool Matches(const Param */*param*/) { return true; }
+};
+
+typedef NetworkShape<0, 0, 0> DynamicNetworkShape;
+
+/* Shape of the training kernels: build with NETWORK_SHAPE=nInput,nHide,nOutput (see makefile) for the production topology,
+   and without it to explore other sizes from Param.cpp */
+#if defined(NETWORK_SHAPE)
+typedef NetworkShape<NETWORK_SHAPE> TrainNetworkShape;
+#else
+typedef DynamicNetworkShape TrainNetworkShape;
+#endif
+
+#endif
@@ -229,6 +229,7 @@ void NeuroSimSubArrayInitialize(SubArray *& subArray, Array *array, InputParamet
 	/* Recalculate wire resistance after possible layout adjustment by NeuroSim */
 	array->wireResistanceRow = subArray->lengthRow / numCol * unitLengthWireResistance; // the wire resistance of each cell along row direction
 	array->wireResistanceCol = subArray->lengthCol / numRow * unitLengthWireResistance; // the wire resistance of each cell along column direction
+	array->UpdateReadPath();
 	/* Transfer the wire capacitances from NeuroSim to MLP simulator */
 	array->wireCapRow = subArray->capRow1;
 	array->wireCapCol = subArray->capCol;
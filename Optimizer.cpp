@@ -0,0 +1,177 @@
+/*******************************************************************************
+* Copyright (c) 2015-2017
+* School of Electrical, Computer and Energy Engineering, Arizona State University
+* PI: Prof. Shimeng Yu
+* All rights reserved.
+*   
+* This source code is part of NeuroSim - a device-circuit-algorithm framework to benchmark 
+* neuro-inspired architectures with synaptic devices(e.g., SRAM and emerging non-volatile memory). 
+* Copyright of the model is maintained by the developers, and the model is distributed under 
+* the terms of the Creative Commons Attribution-NonCommercial 4.0 International Public License 
+* http://creativecommons.org/licenses/by-nc/4.0/legalcode.
+* The source code is free and you can redistribute and/or modify it
+* by providing that the following conditions are met:
+*   
+*  1) Redistributions of source code must retain the above copyright notice,
+*     this list of conditions and the following disclaimer. 
+*   
+*  2) Redistributions in binary form must reproduce the above copyright notice,
+*     this list of conditions and the following disclaimer in the documentation
+*     and/or other materials provided with the distribution.
+*   
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+* Developer list: 
+*   Pai-Yu Chen     Email: pchen72 at asu dot edu 
+*                     
+*   Xiaochen Peng   Email: xpeng15 at asu dot edu
+********************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include "Optimizer.h"
+
+Optimizer::Optimizer(int numRows, int numCols, double learningRate, int batchSize):
+	numRows(numRows), numCols(numCols), learningRate(learningRate), batchSize(batchSize) {}
+
+double *Optimizer::AllocateState() {
+	return new double[(size_t)numRows * numCols]();
+}
+
+bool SGDOptimizer::UpdateRow(int /*k*/, const double *delta, double input, int /*sample*/, double *deltaWeight) {
+	for (int j = 0; j < numCols; j++) {
+		deltaWeight[j] = -learningRate * (delta[j] * input);
+	}
+	return true;
+}
+
+BatchOptimizer::BatchOptimizer(int numRows, int numCols, double learningRate, int batchSize): Optimizer(numRows, numCols, learningRate, batchSize) {
+	gradSum = AllocateState();
+}
+
+BatchOptimizer::~BatchOptimizer() {
+	delete[] gradSum;
+}
+
+bool BatchOptimizer::UpdateRow(int k, const double *delta, double input, int sample, double *deltaWeight) {
+	double *gradSumRow = gradSum + (size_t)k * numCols;
+	AddRowGradient(k, delta, input);
+	if (!IsUpdateSample(sample)) {
+		return false;
+	}
+	ApplyRow(k, gradSumRow, (sample+1) / batchSize, deltaWeight);
+	for (int j = 0; j < numCols; j++) {
+		gradSumRow[j] = 0;
+	}
+	return true;
+}
+
+void BatchOptimizer::AddRowGradient(int k, const double *delta, double input) {
+	double *gradSumRow = gradSum + (size_t)k * numCols;
+	for (int j = 0; j < numCols; j++) {
+		gradSumRow[j] += delta[j] * input;
+	}
+}
+
+MomentumOptimizer::MomentumOptimizer(int numRows, int numCols, double learningRate, int batchSize, double gama):
+	BatchOptimizer(numRows, numCols, learningRate, batchSize), gama(gama) {
+	momentum = AllocateState();
+}
+
+MomentumOptimizer::~MomentumOptimizer() {
+	delete[] momentum;
+}
+
+void MomentumOptimizer::ApplyRow(int k, const double *gradSumRow, int /*step*/, double *deltaWeight) {
+	double *m = momentum + (size_t)k * numCols;
+	for (int j = 0; j < numCols; j++) {	// Momentum uses the summed gradient of the batch
+		m[j] = gama * m[j] + (1 - gama) * gradSumRow[j];
+		deltaWeight[j] = -learningRate * m[j];
+	}
+}
+
+AdagradOptimizer::AdagradOptimizer(int numRows, int numCols, double learningRate, int batchSize, double epsilon):
+	BatchOptimizer(numRows, numCols, learningRate, batchSize), epsilon(epsilon) {
+	gradSquareSum = AllocateState();
+}
+
+AdagradOptimizer::~AdagradOptimizer() {
+	delete[] gradSquareSum;
+}
+
+void AdagradOptimizer::ApplyRow(int k, const double *gradSumRow, int /*step*/, double *deltaWeight) {
+	double *G = gradSquareSum + (size_t)k * numCols;
+	for (int j = 0; j < numCols; j++) {
+		double g = gradSumRow[j] / batchSize;
+		G[j] += g * g;
+		deltaWeight[j] = -learningRate / (sqrt(G[j]) + epsilon) * g;
+	}
+}
+
+RMSpropOptimizer::RMSpropOptimizer(int numRows, int numCols, double learningRate, int batchSize, double gama, double epsilon):
+	BatchOptimizer(numRows, numCols, learningRate, batchSize), gama(gama), epsilon(epsilon) {
+	gradSquare = AllocateState();
+}
+
+RMSpropOptimizer::~RMSpropOptimizer() {
+	delete[] gradSquare;
+}
+
+void RMSpropOptimizer::ApplyRow(int k, const double *gradSumRow, int /*step*/, double *deltaWeight) {
+	double *v = gradSquare + (size_t)k * numCols;
+	for (int j = 0; j < numCols; j++) {
+		double g = gradSumRow[j] / batchSize;
+		v[j] = gama * v[j] + (1 - gama) * g * g;
+		deltaWeight[j] = -learningRate / (sqrt(v[j]) + epsilon) * g;
+	}
+}
+
+AdamOptimizer::AdamOptimizer(int numRows, int numCols, double learningRate, int batchSize, double beta1, double beta2, double epsilon):
+	BatchOptimizer(numRows, numCols, learningRate, batchSize), beta1(beta1), beta2(beta2), epsilon(epsilon) {
+	momentum = AllocateState();
+	velocity = AllocateState();
+}
+
+AdamOptimizer::~AdamOptimizer() {
+	delete[] momentum;
+	delete[] velocity;
+}
+
+void AdamOptimizer::ApplyRow(int k, const double *gradSumRow, int step, double *deltaWeight) {
+	double *m = momentum + (size_t)k * numCols;
+	double *v = velocity + (size_t)k * numCols;
+	double correction1 = 1 - pow(beta1, step);	// Bias correction
+	double correction2 = 1 - pow(beta2, step);
+	for (int j = 0; j < numCols; j++) {
+		double g = gradSumRow[j] / batchSize;
+		m[j] = beta1 * m[j] + (1 - beta1) * g;
+		v[j] = beta2 * v[j] + (1 - beta2) * g * g;
+		deltaWeight[j] = -learningRate * (m[j] / correction1) / (sqrt(v[j] / correction2) + epsilon);
+	}
+}
+
+Optimizer *CreateOptimizer(const char *type, int numRows, int numCols, double learningRate, int batchSize) {
+	if (strcmp(type, "SGD") == 0)
+		return new SGDOptimizer(numRows, numCols, learningRate, batchSize);
+	else if (strcmp(type, "Momentum") == 0)
+		return new MomentumOptimizer(numRows, numCols, learningRate, batchSize);
+	else if (strcmp(type, "Adagrad") == 0)
+		return new AdagradOptimizer(numRows, numCols, learningRate, batchSize);
+	else if (strcmp(type, "RMSprop") == 0)
+		return new RMSpropOptimizer(numRows, numCols, learningRate, batchSize);
+	else if (strcmp(type, "Adam") == 0)
+		return new AdamOptimizer(numRows, numCols, learningRate, batchSize);
+	printf("Unknown optimization type %s, please specify SGD, Momentum, Adagrad, RMSprop or Adam\n", type);
+	exit(-1);
+}
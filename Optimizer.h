@@ -0,0 +1,132 @@
+/*******************************************************************************
+* Copyright (c) 2015-2017
+* School of Electrical, Computer and Energy Engineering, Arizona State University
+* PI: Prof. Shimeng Yu
+* All rights reserved.
+*   
+* This source code is part of NeuroSim - a device-circuit-algorithm framework to benchmark 
+* neuro-inspired architectures with synaptic devices(e.g., SRAM and emerging non-volatile memory). 
+* Copyright of the model is maintained by the developers, and the model is distributed under 
+* the terms of the Creative Commons Attribution-NonCommercial 4.0 International Public License 
+* http://creativecommons.org/licenses/by-nc/4.0/legalcode.
+* The source code is free and you can redistribute and/or modify it
+* by providing that the following conditions are met:
+*   
+*  1) Redistributions of source code must retain the above copyright notice,
+*     this list of conditions and the following disclaimer. 
+*   
+*  2) Redistributions in binary form must reproduce the above copyright notice,
+*     this list of conditions and the following disclaimer in the documentation
+*     and/or other materials provided with the distribution.
+*   
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+* Developer list: 
+*   Pai-Yu Chen     Email: pchen72 at asu dot edu 
+*                     
+*   Xiaochen Peng   Email: xpeng15 at asu dot edu
+********************************************************************************/
+
+#ifndef OPTIMIZER_H_
+#define OPTIMIZER_H_
+
+/* Optimizer of the weights of one synaptic layer, chosen once per run (see CreateOptimizer()).
+   The state is stored in the order of the WU loop: row k (input) by column j (output), so that a row update runs over contiguous memory.
+   Each optimizer only allocates the state it needs (none for SGD). */
+class Optimizer {
+public:
+	int numRows;		// # of rows (inputs of the layer)
+	int numCols;		// # of columns (outputs of the layer)
+	double learningRate;
+	int batchSize;		// # of training samples per weight update of the batch based optimizers
+
+	Optimizer(int numRows, int numCols, double learningRate, int batchSize);
+	virtual ~Optimizer() {}
+
+	virtual bool UpdateEverySample() const { return false; }
+	bool IsUpdateSample(int sample) const { return UpdateEverySample() || (sample+1) % batchSize == 0; }
+	/* Weight change of row k for the gradient delta[j]*input of this sample, written to deltaWeight[0..numCols).
+	   Returns false (and leaves deltaWeight unchanged) if the weights are not updated at this sample */
+	virtual bool UpdateRow(int k, const double *delta, double input, int sample, double *deltaWeight) = 0;
+	/* Add the gradient delta[j]*input of row k of a sample that does not run UpdateRow(), only kept by the batch based optimizers.
+	   Adding the samples in sample order gives the same sums as UpdateRow() of the samples in turn */
+	virtual void AddRowGradient(int /*k*/, const double */*delta*/, double /*input*/) {}
+
+protected:
+	double *AllocateState();	// Zero-initialized numRows x numCols state
+};
+
+class SGDOptimizer: public Optimizer {
+public:
+	SGDOptimizer(int numRows, int numCols, double learningRate, int batchSize): Optimizer(numRows, numCols, learningRate, batchSize) {}
+	bool UpdateEverySample() const { return true; }
+	bool UpdateRow(int k, const double *delta, double input, int sample, double *deltaWeight);
+};
+
+/* Batch based optimizers: the gradients are summed over a batch, and the weights are updated with the batch gradient at its last sample */
+class BatchOptimizer: public Optimizer {
+public:
+	double *gradSum;	// Gradient summed over the current batch
+
+	BatchOptimizer(int numRows, int numCols, double learningRate, int batchSize);
+	virtual ~BatchOptimizer();
+	bool UpdateRow(int k, const double *delta, double input, int sample, double *deltaWeight);
+	void AddRowGradient(int k, const double *delta, double input);
+	/* Weight change of row k from the summed gradient of the batch, step is the # of updates so far including this one */
+	virtual void ApplyRow(int k, const double *gradSumRow, int step, double *deltaWeight) = 0;
+};
+
+class MomentumOptimizer: public BatchOptimizer {
+public:
+	double gama;
+	double *momentum;
+
+	MomentumOptimizer(int numRows, int numCols, double learningRate, int batchSize, double gama=0.3);
+	~MomentumOptimizer();
+	void ApplyRow(int k, const double *gradSumRow, int step, double *deltaWeight);
+};
+
+class AdagradOptimizer: public BatchOptimizer {
+public:
+	double epsilon;
+	double *gradSquareSum;	// Sum of the squared batch gradients
+
+	AdagradOptimizer(int numRows, int numCols, double learningRate, int batchSize, double epsilon=1E-2);
+	~AdagradOptimizer();
+	void ApplyRow(int k, const double *gradSumRow, int step, double *deltaWeight);
+};
+
+class RMSpropOptimizer: public BatchOptimizer {
+public:
+	double gama, epsilon;
+	double *gradSquare;	// Moving average of the squared batch gradient
+
+	RMSpropOptimizer(int numRows, int numCols, double learningRate, int batchSize, double gama=0.9, double epsilon=1E-5);
+	~RMSpropOptimizer();
+	void ApplyRow(int k, const double *gradSumRow, int step, double *deltaWeight);
+};
+
+class AdamOptimizer: public BatchOptimizer {
+public:
+	double beta1, beta2, epsilon;
+	double *momentum;	// Moving average of the batch gradient
+	double *velocity;	// Moving average of the squared batch gradient
+
+	AdamOptimizer(int numRows, int numCols, double learningRate, int batchSize, double beta1=0.9, double beta2=0.9, double epsilon=1E-5);
+	~AdamOptimizer();
+	void ApplyRow(int k, const double *gradSumRow, int step, double *deltaWeight);
+};
+
+/* type: "SGD", "Momentum", "Adagrad", "RMSprop" or "Adam" */
+Optimizer *CreateOptimizer(const char *type, int numRows, int numCols, double learningRate, int batchSize);
+
+#endif
@@ -48,6 +48,10 @@ Param::Param() {
 	/* Algorithm parameters */
 	numTrainImagesPerEpoch = 8000;	// # of training images per epoch 
     numTrainImagesPerBatch = 1;   // # of training images per batch. It is 1 for SGD
+	dataParallelBatch = true;	// Run the samples of a mini-batch concurrently (batch based optimizers with hardware WU)
+	hogwildTraining = false;	// Asynchronous software training: the threads update the weights without locks (software FF and WU only)
+	accumulatePulseWU = false;	// Sum the pulse counts of a mini-batch and write them once at its end (batch based optimizers with hardware WU)
+	numReplicas = 1;	// # of training processes that share the samples and average their updates (synchronous training only, see Replica.h)
 	totalNumEpochs = 30;	// Total number of epochs
 	interNumEpochs = 1;		// Internal number of epochs (print out the results every interNumEpochs)
 	nInput = 400;     // # of neurons in input layer
@@ -58,7 +62,7 @@ Param::Param() {
 	maxWeight = 1;	// Upper bound of weight value
 	minWeight = -1;	// Lower bound of weight value
 	/*Optimization method 
-	Available option include: "SGD", "Momentum", "RMSprop" and "Adam"*/
+	Available option include: "SGD", "Momentum", "Adagrad", "RMSprop" and "Adam"*/
 	optimization_type = "SGD";
 
 
@@ -84,7 +88,8 @@ Param::Param() {
 	processNode = 32;	// Technology node (nm)
 	clkFreq = 2e9;		// Clock frequency (Hz)
 
-	StreamLength = 10;
+	StreamLength = 10;	// # of time slots of the stochastic pulse trains in the WU
+	binomialPulseWU = false;	// True: draw the pulse count of each cell from Binomial(StreamLength, p_input*p_delta) instead of generating the pulse trains
  
 }
 
@@ -52,6 +52,10 @@ public:
 	/* Algorithm parameters */
 	int numTrainImagesPerEpoch;	// # of training images per epoch
     int numTrainImagesPerBatch;
+	bool dataParallelBatch;	// Run the samples of a mini-batch concurrently (batch based optimizers with hardware WU)
+	bool hogwildTraining;	// Asynchronous software training: the threads update the weights without locks (software FF and WU only)
+	bool accumulatePulseWU;	// Sum the pulse counts of a mini-batch and write them once at its end (batch based optimizers with hardware WU)
+	int numReplicas;	// # of training processes that share the samples and average their updates (see Replica.h)
 	int totalNumEpochs;	// Total number of epochs
 	int interNumEpochs;	// Internal number of epochs (print out the results every interNumEpochs)
 	int nInput;     // # of neurons in input layer
@@ -85,7 +89,8 @@ public:
 	int processNode;	// Technology node (nm)
 	double clkFreq;		// Clock frequency (Hz)
 
-	int StreamLength;
+	int StreamLength;	// # of time slots of the stochastic pulse trains in the WU
+	bool binomialPulseWU;	// True: draw the pulse count of each cell from Binomial(StreamLength, p_input*p_delta) instead of generating the pulse trains
 };
 
 #endif
@@ -0,0 +1,154 @@
+/*******************************************************************************
+* Copyright (c) 2015-2017
+* School of Electrical, Computer and Energy Engineering, Arizona State University
+* PI: Prof. Shimeng Yu
+* All rights reserved.
+*   
+* This source code is part of NeuroSim - a device-circuit-algorithm framework to benchmark 
+* neuro-inspired architectures with synaptic devices(e.g., SRAM and emerging non-volatile memory). 
+* Copyright of the model is maintained by the developers, and the model is distributed under 
+* the terms of the Creative Commons Attribution-NonCommercial 4.0 International Public License 
+* http://creativecommons.org/licenses/by-nc/4.0/legalcode.
+* The source code is free and you can redistribute and/or modify it
+* by providing that the following conditions are met:
+*   
+*  1) Redistributions of source code must retain the above copyright notice,
+*     this list of conditions and the following disclaimer. 
+*   
+*  2) Redistributions in binary form must reproduce the above copyright notice,
+*     this list of conditions and the following disclaimer in the documentation
+*     and/or other materials provided with the distribution.
+*   
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+* Developer list: 
+*   Pai-Yu Chen     Email: pchen72 at asu dot edu 
+*                     
+*   Xiaochen Peng   Email: xpeng15 at asu dot edu
+********************************************************************************/
+
+#ifndef PULSETRAIN_H_
+#define PULSETRAIN_H_
+
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "RNG.h"
+
+/* Stochastic pulse trains of a set of neurons for the stochastic pulse WU, packed 64 time slots per word.
+   The LTP and LTD phases of a train are kept in separate words, so that the coincidences of an input train and a delta
+   train are counted with AND + popcount. The buffers are reused from sample to sample. */
+class PulseTrainSet {
+public:
+	int numTrains;		// # of neurons
+	int streamLength;	// # of time slots of each phase
+	int numWords;		// # of 64-bit words of each phase
+	std::vector<uint64_t> LTP;	// LTP phase of each train, numTrains x numWords
+	std::vector<uint64_t> LTD;	// LTD phase of each train, numTrains x numWords
+
+	PulseTrainSet(int numTrains, int streamLength): numTrains(numTrains), streamLength(streamLength),
+		numWords((streamLength + 63) / 64), LTP((size_t)numTrains * numWords), LTD((size_t)numTrains * numWords) {}
+
+	/* Draw train n, each slot of both phases firing with the given probability (the LTP and LTD slots of time t are drawn in turn) */
+	void Generate(int n, RandomStream &random, double probability) {
+		uint64_t *ltp = &LTP[(size_t)n * numWords];
+		uint64_t *ltd = &LTD[(size_t)n * numWords];
+		std::fill(ltp, ltp + numWords, 0);
+		std::fill(ltd, ltd + numWords, 0);
+		if (probability <= 0) {	// No pulse (and the stream of this train needs no draws)
+			return;
+		}
+		std::bernoulli_distribution dis(probability);
+		for (int t = 0; t < streamLength; t++) {
+			uint64_t bit = (uint64_t)1 << (t % 64);
+			if (dis(random))
+				ltp[t / 64] |= bit;
+			if (dis(random))
+				ltd[t / 64] |= bit;
+		}
+	}
+	const uint64_t *GetLTP(int n) const { return &LTP[(size_t)n * numWords]; }
+	const uint64_t *GetLTD(int n) const { return &LTD[(size_t)n * numWords]; }
+};
+
+/* # of time slots where both trains fire */
+inline int CountCoincidence(const uint64_t *a, const uint64_t *b, int numWords) {
+	int count = 0;
+	for (int w = 0; w < numWords; w++) {
+		count += __builtin_popcountll(a[w] & b[w]);
+	}
+	return count;
+}
+
+/* Cells of each row with a nonzero pulse count in the stochastic pulse WU, in column order.
+   The sparse WU only writes the write batches that hold an entry of this list. */
+class PulseWorklist {
+public:
+	int numRows;	// # of rows (inputs of the array)
+	int numCols;	// # of columns (outputs of the array)
+	std::vector<unsigned short> column;	// Columns with a nonzero pulse count of each row, numRows x numCols
+	std::vector<int> numEntries;		// # of entries of each row
+
+	PulseWorklist(int numRows, int numCols): numRows(numRows), numCols(numCols),
+		column((size_t)numRows * numCols), numEntries(numRows) {
+		if (numCols > 65536) {	// The columns are stored as unsigned short
+			printf("[Error] numCols=%d is too large for the pulse worklist\n", numCols);
+			exit(-1);
+		}
+	}
+
+	/* Collect the nonzero pulse counts of row n (pulseRow is the pulse count of each column) */
+	void Build(int n, const int *pulseRow) {
+		unsigned short *entry = &column[(size_t)n * numCols];
+		int count = 0;
+		for (int m = 0; m < numCols; m++) {
+			if (pulseRow[m] != 0) {
+				entry[count++] = m;
+			}
+		}
+		numEntries[n] = count;
+	}
+	const unsigned short *GetColumns(int n) const { return &column[(size_t)n * numCols]; }
+	int GetNumEntries(int n) const { return numEntries[n]; }
+};
+
+/* Pulse counts of each cell summed over the samples of a mini-batch (accumulate-then-write WU), saturated to int16.
+   The counts of a batch are written to the cells once, at its last sample. */
+class PulseAccumulator {
+public:
+	int numRows;	// # of rows (inputs of the array)
+	int numCols;	// # of columns (outputs of the array)
+	std::vector<short> sum;	// Summed pulse count of each cell (LTD is negative), numRows x numCols
+
+	PulseAccumulator(int numRows, int numCols): numRows(numRows), numCols(numCols), sum((size_t)numRows * numCols) {}
+
+	/* Add the pulse counts of row n of this sample */
+	void Add(int n, const int *pulseRow) {
+		short *rowSum = &sum[(size_t)n * numCols];
+		for (int m = 0; m < numCols; m++) {
+			rowSum[m] = (short)std::max(-32768, std::min(32767, rowSum[m] + pulseRow[m]));
+		}
+	}
+	/* Move the summed counts of row n to pulseRow and restart the sum */
+	void Flush(int n, int *pulseRow) {
+		short *rowSum = &sum[(size_t)n * numCols];
+		for (int m = 0; m < numCols; m++) {
+			pulseRow[m] = rowSum[m];
+			rowSum[m] = 0;
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,159 @@
+/*******************************************************************************
+* Copyright (c) 2015-2017
+* School of Electrical, Computer and Energy Engineering, Arizona State University
+* PI: Prof. Shimeng Yu
+* All rights reserved.
+*   
+* This source code is part of NeuroSim - a device-circuit-algorithm framework to benchmark 
+* neuro-inspired architectures with synaptic devices(e.g., SRAM and emerging non-volatile memory). 
+* Copyright of the model is maintained by the developers, and the model is distributed under 
+* the terms of the Creative Commons Attribution-NonCommercial 4.0 International Public License 
+* http://creativecommons.org/licenses/by-nc/4.0/legalcode.
+* The source code is free and you can redistribute and/or modify it
+* by providing that the following conditions are met:
+*   
+*  1) Redistributions of source code must retain the above copyright notice,
+*     this list of conditions and the following disclaimer. 
+*   
+*  2) Redistributions in binary form must reproduce the above copyright notice,
+*     this list of conditions and the following disclaimer in the documentation
+*     and/or other materials provided with the distribution.
+*   
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+* Developer list: 
+*   Pai-Yu Chen     Email: pchen72 at asu dot edu 
+*                     
+*   Xiaochen Peng   Email: xpeng15 at asu dot edu
+********************************************************************************/
+
+#ifndef RNG_H_
+#define RNG_H_
+
+#include <cmath>
+#include <stdint.h>
+#include <random>
+
+/* Position of the simulation, part of the key of every random stream.
+   It is threadprivate: the thread that sets it is the one whose draws it keys (use copyin to pass it to a parallel region). */
+struct RandomPhase {
+	uint32_t seed;		// Seed of the whole simulation
+	uint32_t epoch;		// # of training epochs done so far
+	uint32_t sample;	// Sample in the current epoch (training) or image index (validation)
+	uint32_t stage;		// RANDOM_TRAIN or RANDOM_TEST
+	uint32_t step;		// Bit plane of the input vector (read noise)
+};
+extern RandomPhase randomPhase;
+#pragma omp threadprivate(randomPhase)
+
+enum RandomStage { RANDOM_TRAIN, RANDOM_TEST, RANDOM_DEVICE };
+
+/* Stream id = op (bit 31) | domain (bits 28-30) | sub-cell (bits 26-27) | index (bits 0-25) */
+enum RandomDomain {
+	RANDOM_ARRAY_IH,		// Cells of arrayIH (index = Array::CellIndex)
+	RANDOM_ARRAY_HO,		// Cells of arrayHO
+	RANDOM_PULSE_INPUT_IH,	// Stochastic pulse trains of the inputs of arrayIH (index = row)
+	RANDOM_PULSE_DELTA_IH,	// Stochastic pulse trains of the deltas of arrayIH (index = column)
+	RANDOM_PULSE_INPUT_HO,
+	RANDOM_PULSE_DELTA_HO,
+	RANDOM_PULSE_COUNT_IH,	// Binomial pulse counts of the cells of arrayIH (index = row * # of columns + column)
+	RANDOM_PULSE_COUNT_HO
+};
+const uint32_t RANDOM_SUBCELL_SHIFT = 26;	// Sub-cells of a compound cell (e.g. HybridCell)
+const uint32_t RANDOM_READ = 0;
+const uint32_t RANDOM_WRITE = 1u << 31;
+/* randomPhase.step of the reads outside the FF (read-back in the WU, weight transfer). The FF reads of a cell are keyed by the bit
+   plane (step < RANDOM_STEP_READBACK) and may run in several threads at once, while each of these reads takes the next read count of the cell */
+const uint32_t RANDOM_STEP_READBACK = 0x8000;
+
+inline uint32_t RandomStreamId(int domain, int index) {
+	return (uint32_t)domain << 28 | (uint32_t)index;
+}
+
+/* Philox4x32-10 block function (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC'11).
+   Maps a 128-bit counter and a 64-bit key to 128 random bits */
+inline void Philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]) {
+	uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+	uint32_t k0 = key[0], k1 = key[1];
+	for (int r=0; r<10; r++) {
+		uint64_t p0 = (uint64_t)0xD2511F53 * c0;
+		uint64_t p1 = (uint64_t)0xCD9E8D57 * c2;
+		uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+		uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+		c1 = (uint32_t)p1;
+		c3 = (uint32_t)p0;
+		c0 = n0;
+		c2 = n2;
+		k0 += 0x9E3779B9;
+		k1 += 0xBB67AE85;
+	}
+	out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+/* Counter-based random stream keyed by (seed, epoch, sample, stage, step, stream id).
+   Streams with different keys are independent and need no shared state, so each cell or neuron draws from its own
+   stream in any thread and the results do not depend on the # of threads.
+   It is a uniform random bit generator, so it also works with the <random> distributions. */
+class RandomStream {
+public:
+	typedef uint32_t result_type;
+
+	RandomStream(uint32_t streamId, uint32_t step) {
+		key[0] = randomPhase.seed;
+		key[1] = randomPhase.epoch;
+		counter[0] = 0;
+		counter[1] = streamId;
+		counter[2] = randomPhase.sample;
+		counter[3] = randomPhase.stage << 16 | (step & 0xFFFF);
+		numLeft = 0;
+	}
+	/* One-time device-to-device variation of a cell: keyed by the seed (replica) and the stream id only, so it does not depend
+	   on when the cell is set up, and a fixed seed gives the same devices in every run */
+	static RandomStream DeviceVariation(uint32_t streamId) {
+		RandomStream random(streamId, 0);
+		random.key[1] = 0;
+		random.counter[2] = 0;
+		random.counter[3] = RANDOM_DEVICE << 16;
+		return random;
+	}
+
+	result_type operator()() {
+		if (numLeft == 0) {
+			Philox4x32(counter, key, block);
+			counter[0]++;
+			numLeft = 4;
+		}
+		return block[4 - numLeft--];
+	}
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return 0xFFFFFFFF; }
+
+	/* Uniform in [0, 1) with 53 random bits */
+	double Uniform() {
+		uint32_t a = (*this)() >> 5, b = (*this)() >> 6;
+		return (a * 67108864.0 + b) * (1.0 / 9007199254740992.0);
+	}
+	/* Gaussian with the mean and sigma of dist (Box-Muller, no state carried between draws unlike std::normal_distribution) */
+	double Normal(const std::normal_distribution<double> &dist) {
+		double u1 = 1 - Uniform();	// (0, 1]
+		double u2 = Uniform();
+		return dist.mean() + dist.stddev() * sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+	}
+
+private:
+	uint32_t key[2];
+	uint32_t counter[4];	// counter[0] is the block index within the stream
+	uint32_t block[4];
+	int numLeft;	// # of unused words in block
+};
+
+#endif
@@ -0,0 +1,229 @@
+/*******************************************************************************
+* Copyright (c) 2015-2017
+* School of Electrical, Computer and Energy Engineering, Arizona State University
+* PI: Prof. Shimeng Yu
+* All rights reserved.
+*   
+* This source code is part of NeuroSim - a device-circuit-algorithm framework to benchmark 
+* neuro-inspired architectures with synaptic devices(e.g., SRAM and emerging non-volatile memory). 
+* Copyright of the model is maintained by the developers, and the model is distributed under 
+* the terms of the Creative Commons Attribution-NonCommercial 4.0 International Public License 
+* http://creativecommons.org/licenses/by-nc/4.0/legalcode.
+* The source code is free and you can redistribute and/or modify it
+* by providing that the following conditions are met:
+*   
+*  1) Redistributions of source code must retain the above copyright notice,
+*     this list of conditions and the following disclaimer. 
+*   
+*  2) Redistributions in binary form must reproduce the above copyright notice,
+*     this list of conditions and the following disclaimer in the documentation
+*     and/or other materials provided with the distribution.
+*   
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+* Developer list: 
+*   Pai-Yu Chen     Email: pchen72 at asu dot edu 
+*                     
+*   Xiaochen Peng   Email: xpeng15 at asu dot edu
+********************************************************************************/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include "Replica.h"
+
+static ReplicaGroup *startedGroup = NULL;	// Group whose children the SIGCHLD handler of the parent watches
+
+/* A replica that fails (exit(-1) on an error, or a crash) would leave the others blocked at the next barrier, so the parent
+   kills the whole group as soon as one of its children ends with an error (a child that passed the barrier of Stop() may
+   already end normally before the parent gets there) */
+static void AbortOnReplicaExit(int) {
+	ReplicaGroup *group = startedGroup;
+	bool failed = false;
+	for (int r = 1; r < group->numReplicas; r++) {
+		int status;
+		if (group->child[r] > 0 && waitpid(group->child[r], &status, WNOHANG) == group->child[r]) {
+			group->child[r] = 0;
+			if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+				failed = true;
+			}
+		}
+	}
+	if (failed) {
+		for (int r = 1; r < group->numReplicas; r++) {
+			if (group->child[r] > 0) {
+				kill(group->child[r], SIGKILL);
+			}
+		}
+		const char msg[] = "[Error] A replica ended before the end of the training, aborting all replicas\n";
+		if (write(STDOUT_FILENO, msg, sizeof(msg) - 1) < 0) {}
+		_exit(-1);
+	}
+}
+
+ReplicaGroup::ReplicaGroup(int numReplicas, size_t slotSize): numReplicas(numReplicas), replica(0), slotSize(slotSize), ring(0),
+	barrier(NULL), slot(NULL), segmentBytes(0), child(NULL) {
+	if (numReplicas < 1) {
+		printf("[Error] The # of replicas must be at least 1\n");
+		exit(-1);
+	}
+}
+
+void ReplicaGroup::Start() {
+	if (!IsActive()) {
+		return;
+	}
+	size_t headerBytes = (sizeof(pthread_barrier_t) + 63) / 64 * 64;
+	segmentBytes = headerBytes + 2 * numReplicas * slotSize * sizeof(double);
+
+	/* The name is only needed until the mapping is inherited, so it is removed right away */
+	char name[64];
+	sprintf(name, "/neurosim_replica_%d", (int)getpid());
+	int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd < 0) {
+		printf("[Error] Cannot create the shared memory segment %s of the replicas\n", name);
+		exit(-1);
+	}
+	void *addr = MAP_FAILED;
+	if (ftruncate(fd, segmentBytes) == 0) {
+		addr = mmap(NULL, segmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+	shm_unlink(name);
+	if (addr == MAP_FAILED) {
+		printf("[Error] Cannot map the shared memory segment of the replicas (%lu bytes)\n", (unsigned long)segmentBytes);
+		exit(-1);
+	}
+	barrier = (pthread_barrier_t *)addr;
+	slot = (double *)((char *)addr + headerBytes);
+
+	pthread_barrierattr_t attr;
+	pthread_barrierattr_init(&attr);
+	pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	pthread_barrier_init(barrier, &attr, numReplicas);
+	pthread_barrierattr_destroy(&attr);
+
+	fflush(stdout);	// Otherwise the children print the buffered output again
+	child = new pid_t[numReplicas];
+	pid_t parent = getpid();
+	startedGroup = this;
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = AbortOnReplicaExit;
+	action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGCHLD, &action, NULL);
+	for (int r = 1; r < numReplicas; r++) {
+		child[r] = 0;
+	}
+	for (int r = 1; r < numReplicas; r++) {
+		pid_t pid = fork();
+		if (pid < 0) {
+			printf("[Error] Cannot fork replica %d\n", r);
+			exit(-1);
+		}
+		if (pid == 0) {
+			signal(SIGCHLD, SIG_DFL);
+			prctl(PR_SET_PDEATHSIG, SIGKILL);	// The children go down with the parent (e.g. when it exits on an error)
+			if (getppid() != parent) {
+				_exit(-1);
+			}
+			replica = r;
+			delete[] child;
+			child = NULL;
+			if (!freopen("/dev/null", "w", stdout)) {	// Only replica 0 prints the results
+				exit(-1);
+			}
+			return;
+		}
+		child[r] = pid;
+	}
+}
+
+void ReplicaGroup::Stop() {
+	if (!IsActive()) {
+		return;
+	}
+	Barrier();
+	if (replica == 0) {
+		signal(SIGCHLD, SIG_DFL);	// The children end normally from here on
+		startedGroup = NULL;
+		for (int r = 1; r < numReplicas; r++) {
+			if (child[r] > 0) {
+				waitpid(child[r], NULL, 0);
+			}
+		}
+		pthread_barrier_destroy(barrier);
+		delete[] child;
+		child = NULL;
+	}
+	munmap(barrier, segmentBytes);
+	barrier = NULL;
+	slot = NULL;
+}
+
+void ReplicaGroup::Barrier() {
+	if (IsActive()) {
+		pthread_barrier_wait(barrier);
+	}
+}
+
+void ReplicaGroup::AllReduce(double *data, size_t count) {
+	if (!IsActive()) {
+		return;
+	}
+	if (count > slotSize) {
+		printf("[Error] All-reduce of %lu values exceeds the slot size of the replicas (%lu)\n", (unsigned long)count, (unsigned long)slotSize);
+		exit(-1);
+	}
+	double *set = slot + (size_t)ring * numReplicas * slotSize;
+	memcpy(set + replica * slotSize, data, count * sizeof(double));
+	pthread_barrier_wait(barrier);
+	for (size_t n = 0; n < count; n++) {
+		double sum = 0;
+		for (int r = 0; r < numReplicas; r++) {	// Same order in every replica
+			sum += set[r * slotSize + n];
+		}
+		data[n] = sum;
+	}
+	ring ^= 1;
+}
+
+void ReplicaGroup::AllReduceAverage(int *data, size_t count) {
+	if (!IsActive()) {
+		return;
+	}
+	if (count > slotSize) {
+		printf("[Error] All-reduce of %lu values exceeds the slot size of the replicas (%lu)\n", (unsigned long)count, (unsigned long)slotSize);
+		exit(-1);
+	}
+	double *set = slot + (size_t)ring * numReplicas * slotSize;
+	double *mine = set + replica * slotSize;
+	for (size_t n = 0; n < count; n++) {
+		mine[n] = data[n];
+	}
+	pthread_barrier_wait(barrier);
+	for (size_t n = 0; n < count; n++) {
+		double sum = 0;
+		for (int r = 0; r < numReplicas; r++) {
+			sum += set[r * slotSize + n];
+		}
+		data[n] = (int)round(sum / numReplicas);
+	}
+	ring ^= 1;
+}
@@ -0,0 +1,78 @@
+/*******************************************************************************
+* Copyright (c) 2015-2017
+* School of Electrical, Computer and Energy Engineering, Arizona State University
+* PI: Prof. Shimeng Yu
+* All rights reserved.
+*   
+* This source code is part of NeuroSim - a device-circuit-algorithm framework to benchmark 
+* neuro-inspired architectures with synaptic devices(e.g., SRAM and emerging non-volatile memory). 
+* Copyright of the model is maintained by the developers, and the model is distributed under 
+* the terms of the Creative Commons Attribution-NonCommercial 4.0 International Public License 
+* http://creativecommons.org/licenses/by-nc/4.0/legalcode.
+* The source code is free and you can redistribute and/or modify it
+* by providing that the following conditions are met:
+*   
+*  1) Redistributions of source code must retain the above copyright notice,
+*     this list of conditions and the following disclaimer. 
+*   
+*  2) Redistributions in binary form must reproduce the above copyright notice,
+*     this list of conditions and the following disclaimer in the documentation
+*     and/or other materials provided with the distribution.
+*   
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+* Developer list: 
+*   Pai-Yu Chen     Email: pchen72 at asu dot edu 
+*                     
+*   Xiaochen Peng   Email: xpeng15 at asu dot edu
+********************************************************************************/
+#ifndef REPLICA_H_
+#define REPLICA_H_
+
+#include <cstddef>
+#include <pthread.h>
+#include <sys/types.h>
+
+/* Local multi-process data-parallel training: numReplicas processes on one node each train on their shard of the sample stream
+   and with their own arrays (device variation and random streams keyed by the replica), and average the gradients or
+   pulse counts of each update through a POSIX shared-memory segment.
+   The segment holds a ring of 2 sets of slots (one slot per replica): an all-reduce writes the slot of the replica in the
+   current set, waits at a process-shared barrier, and then every replica sums the slots in the replica order, so that all
+   replicas get the same result and it is deterministic for a fixed seed and # of replicas. The next all-reduce uses the other
+   set, which nobody reads any more once all replicas have passed the barrier. */
+class ReplicaGroup {
+public:
+	int numReplicas;	// # of processes
+	int replica;		// Replica of this process (0 is the parent, which prints the results)
+	size_t slotSize;	// Max # of values of an all-reduce
+	int ring;			// Set of slots of the next all-reduce (0 or 1)
+	pthread_barrier_t *barrier;	// In the shared segment
+	double *slot;		// 2 x numReplicas slots of slotSize values, in the shared segment
+	size_t segmentBytes;
+	pid_t *child;		// Processes of replicas 1 .. numReplicas-1 (parent only)
+
+	ReplicaGroup(int numReplicas, size_t slotSize);
+	/* Map the shared segment and fork the replicas. It must be called before the first OpenMP parallel region,
+	   since the thread pool of the runtime does not survive a fork.
+	   From here until Stop(), a replica that exits (e.g. exit(-1) on an error) takes the whole group down with it */
+	void Start();
+	/* Wait for the other replicas and unmap the segment (the parent also reaps the children) */
+	void Stop();
+	void Barrier();
+	/* Sum of data[0..count) over the replicas, written back to data */
+	void AllReduce(double *data, size_t count);
+	/* Pulse counts of data[0..count) averaged over the replicas (rounded to the nearest count) */
+	void AllReduceAverage(int *data, size_t count);
+	bool IsActive() const { return numReplicas > 1; }
+};
+
+#endif
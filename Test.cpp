@@ -46,12 +46,14 @@
 #include "Mapping.h"
 #include "NeuroSim.h"
 #include "Cell.h"
+#include "Dataset.h"
+#include "Crossbar.h"
+#include "RNG.h"
 
 extern Param *param;
 
-extern std::vector< std::vector<double> > testInput;
-extern std::vector< std::vector<int> > dTestInput;
-extern std::vector< std::vector<double> > testOutput;
+extern Dataset *trainSet;
+extern Dataset *testSet;
 
 extern std::vector< std::vector<double> > weight1;
 extern std::vector< std::vector<double> > weight2;
@@ -75,12 +77,38 @@ extern Subtractor subtractorHO;
 
 extern int correct;		// # of correct prediction
 
+/* Mean squared error of the software network (weight1 and weight2) over the first numImages training images, to check the convergence of the training */
+double TrainingLoss(int numImages) {
+	double sumError = 0;
+	#pragma omp parallel for reduction(+: sumError)
+	for (int i = 0; i < numImages; i++) {
+		double a1[param->nHide];
+		for (int j = 0; j < param->nHide; j++) {
+			double outN1 = 0;
+			for (int k = 0; k < param->nInput; k++) {
+				outN1 += trainSet->GetInput(i, k) * weight1[j][k];
+			}
+			a1[j] = sigmoid(outN1);
+		}
+		for (int j = 0; j < param->nOutput; j++) {
+			double outN2 = 0;
+			for (int k = 0; k < param->nHide; k++) {
+				outN2 += a1[k] * weight2[j][k];
+			}
+			double error = trainSet->GetOutput(i, j) - sigmoid(outN2);
+			sumError += error * error;
+		}
+	}
+	return sumError / numImages;
+}
+
 /* Validation */
 void Validate() {
 	int numBatchReadSynapse;    // # of read synapses in a batch read operation (decide later)
 	double outN1[param->nHide]; // Net input to the hidden layer [param->nHide]
 	double a1[param->nHide];    // Net output of hidden layer [param->nHide] also the input of hidden layer to output layer
 	int da1[param->nHide];  // Digitized net output of hidden layer [param->nHide] also the input of hidden layer to output layer
+	ActiveRowList da1Rows(param->nHide, param->numBitInput);  // Active rows of da1 for each bit plane
 	double outN2[param->nOutput];   // Net input to the output layer [param->nOutput]
 	double a2[param->nOutput];  // Net output of output layer [param->nOutput]
 	double tempMax;
@@ -95,14 +123,14 @@ void Validate() {
 	double sumArrayReadEnergyHO = 0;    // Use a temporary variable here since OpenMP does not support reduction on class member
 	double sumNeuroSimReadEnergyHO = 0; // Use a temporary variable here since OpenMP does not support reduction on class member
 	double sumReadLatencyHO = 0;    // Use a temporary variable here since OpenMP does not support reduction on class member
-    if(eNVM* temp = dynamic_cast<eNVM*>(arrayIH->cell[0][0]))
+    if(arrayIH->IsENVM())
     {
         readVoltageIH = static_cast<eNVM*>(arrayIH->cell[0][0])->readVoltage;
         readVoltageHO = static_cast<eNVM*>(arrayHO->cell[0][0])->readVoltage;
         readPulseWidthIH = static_cast<eNVM*>(arrayIH->cell[0][0])->readPulseWidth;
 	    readPulseWidthHO = static_cast<eNVM*>(arrayHO->cell[0][0])->readPulseWidth;
     }
-    else if(HybridCell* temp = dynamic_cast<HybridCell*>(arrayIH->cell[0][0]))
+    else if(arrayIH->IsHybridCell())
     {         
          readVoltageIH = static_cast<HybridCell*>(arrayIH->cell[0][0])->LSBcell.readVoltage;
         readVoltageHO = static_cast<HybridCell*>(arrayHO->cell[0][0])->LSBcell.readVoltage;
@@ -113,174 +141,190 @@ void Validate() {
 
     }
     
-    #pragma omp parallel for private(outN1, a1, da1, outN2, a2, tempMax, countNum, numBatchReadSynapse) reduction(+: correct, sumArrayReadEnergyIH, sumNeuroSimReadEnergyIH, sumArrayReadEnergyHO, sumNeuroSimReadEnergyHO, sumReadLatencyIH, sumReadLatencyHO)
+    #pragma omp parallel for private(outN1, a1, da1, outN2, a2, tempMax, countNum, numBatchReadSynapse) firstprivate(da1Rows) reduction(+: correct, sumArrayReadEnergyIH, sumNeuroSimReadEnergyIH, sumArrayReadEnergyHO, sumNeuroSimReadEnergyHO, sumReadLatencyIH, sumReadLatencyHO) copyin(randomPhase)
 	for (int i = 0; i < param->numMnistTestImages; i++)
 	{
+		randomPhase.stage = RANDOM_TEST;	// Key of the random streams of this image
+		randomPhase.sample = i;
 		// Forward propagation
 		/* First layer from input layer to the hidden layer */
 		std::fill_n(outN1, param->nHide, 0);
 		std::fill_n(a1, param->nHide, 0);
 		if (param->useHardwareInTestingFF) {    // Hardware
-			for (int j=0; j<param->nHide; j++) {
-				if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(arrayIH->cell[0][0])) {  // Analog eNVM
-					if (static_cast<eNVM*>(arrayIH->cell[0][0])->cmosAccess) {  // 1T1R
-						sumArrayReadEnergyIH += arrayIH->wireGateCapRow * techIH.vdd * techIH.vdd * param->nInput; // All WLs open
-					}
-				} else if (DigitalNVM *temp = dynamic_cast<DigitalNVM*>(arrayIH->cell[0][0])) { // Digital eNVM
-					if (static_cast<eNVM*>(arrayIH->cell[0][0])->cmosAccess) {  // 1T1R
-						sumArrayReadEnergyIH += arrayIH->wireGateCapRow * techIH.vdd * techIH.vdd;  // Selected WL
-					} else {    // Cross-point
-						sumArrayReadEnergyIH += arrayIH->wireCapRow * techIH.vdd * techIH.vdd * (param->nInput - 1);    // Unselected WLs
-					}
-				}else if (HybridCell *temp = dynamic_cast<HybridCell*>(arrayIH->cell[0][0]))  // 3T1C cell
-						sumArrayReadEnergyIH += arrayIH->wireGateCapRow * techIH.vdd * techIH.vdd * param->nInput; // All WLs open
+			if (arrayIH->IsAnalogNVM() && arrayIH->cachedReadCurrent) {	// Analog eNVM, all columns read at once
+				if (static_cast<eNVM*>(arrayIH->cell[0][0])->cmosAccess) {  // 1T1R
+					sumArrayReadEnergyIH += arrayIH->wireGateCapRow * techIH.vdd * techIH.vdd * param->nInput * param->nHide; // All WLs open
+				}
+				const unsigned short *activeRows[param->numBitInput];
+				int numActiveRows[param->numBitInput];
+				for (int n=0; n<param->numBitInput; n++) {
+					activeRows[n] = testSet->GetActiveRows(i, n);
+					numActiveRows[n] = testSet->GetNumActiveRows(i, n);
+				}
+				AnalogLayerForward(arrayIH, param->nHide, activeRows, numActiveRows, outN1, a1, da1, sumArrayReadEnergyIH);
+			} else {
+				for (int j=0; j<param->nHide; j++) {
+					if (arrayIH->IsAnalogNVM()) {  // Analog eNVM
+						if (static_cast<eNVM*>(arrayIH->cell[0][0])->cmosAccess) {  // 1T1R
+							sumArrayReadEnergyIH += arrayIH->wireGateCapRow * techIH.vdd * techIH.vdd * param->nInput; // All WLs open
+						}
+					} else if (arrayIH->IsDigitalNVM()) { // Digital eNVM
+						if (static_cast<eNVM*>(arrayIH->cell[0][0])->cmosAccess) {  // 1T1R
+							sumArrayReadEnergyIH += arrayIH->wireGateCapRow * techIH.vdd * techIH.vdd;  // Selected WL
+						} else {    // Cross-point
+							sumArrayReadEnergyIH += arrayIH->wireCapRow * techIH.vdd * techIH.vdd * (param->nInput - 1);    // Unselected WLs
+						}
+					}else if (arrayIH->IsHybridCell())  // 3T1C cell
+							sumArrayReadEnergyIH += arrayIH->wireGateCapRow * techIH.vdd * techIH.vdd * param->nInput; // All WLs open
 				
-                for (int n=0; n<param->numBitInput; n++) {
-					double pSumMaxAlgorithm = pow(2, n) / (param->numInputLevel - 1) * arrayIH->arrayRowSize;   // Max algorithm partial weighted sum for the nth vector bit (if both max input value and max weight are 1)
-					if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(arrayIH->cell[0][0])) {  // Analog eNVM
-						double Isum = 0;    // weighted sum current
-						double IsumMax = 0; // Max weighted sum current
-						double IsumMin = 0; // Max weighted sum current
-						double inputSum = 0;    // Weighted sum current of input vector * weight=1 column
-						for (int k=0; k<param->nInput; k++) {
-							if ((dTestInput[i][k]>>n) & 1) {    // if the nth bit of dTestInput[i][k] is 1
+	                for (int n=0; n<param->numBitInput; n++) {
+						randomPhase.step = n;	// Read noise of this bit plane
+						double pSumMaxAlgorithm = pow(2, n) / (param->numInputLevel - 1) * arrayIH->arrayRowSize;   // Max algorithm partial weighted sum for the nth vector bit (if both max input value and max weight are 1)
+						if (arrayIH->IsAnalogNVM()) {  // Analog eNVM
+							double Isum = 0;    // weighted sum current
+							double IsumMax = arrayIH->columnMaxReadCurrent[j]; // Max weighted sum current (cached per column)
+							double IsumMin = arrayIH->columnMinReadCurrent[j];
+							double inputSum = 0;    // Weighted sum current of input vector * weight=1 column
+							const unsigned short *activeRows = testSet->GetActiveRows(i, n);    // rows whose nth input bit is 1
+							int numActiveRows = testSet->GetNumActiveRows(i, n);
+							for (int a=0; a<numActiveRows; a++) {
+								int k = activeRows[a];
 								Isum += arrayIH->ReadCell(j,k);
-								inputSum += arrayIH->GetMediumCellReadCurrent(j,k);
+								inputSum += arrayIH->mediumReadCurrent[arrayIH->CellIndex(j, k)];
 								sumArrayReadEnergyIH += arrayIH->wireCapRow * readVoltageIH * readVoltageIH;   // Selected BLs (1T1R) or Selected WLs (cross-point)
 							}
-							IsumMax += arrayIH->GetMaxCellReadCurrent(j,k);
-							IsumMin += arrayIH->GetMinCellReadCurrent(j,k);
-						}
-						sumArrayReadEnergyIH += Isum * readVoltageIH * readPulseWidthIH;
-						int outputDigits = (CurrentToDigits(Isum, IsumMax-IsumMin)-CurrentToDigits(inputSum, IsumMax-IsumMin));
-                        //int outputDigits = (CurrentToDigits(Isum, IsumMax)-CurrentToDigits(inputSum, IsumMax));
-						outN1[j] += DigitsToAlgorithm(outputDigits, pSumMaxAlgorithm);
-					} 
-                    else if(HybridCell* temp = dynamic_cast<HybridCell*>(arrayIH->cell[0][0]))
-                    {
-                        double Isum_LSB = 0;              // weighted sum current of the LTP cell
-                        double Isum_MSB_LTP = 0;    // weighted sum current of the LTP cell
-                        double Isum_MSB_LTD = 0;    // weighted sum current of the LTP cell
-                        double IsumMax_LSB = 0;            //the maximum weight sum current (all cells are at high conductance)
-                        double IsumMin_LSB = 0;
-                        double IsumMax_MSB = 0;
-                        double IsumMin_MSB = 0;                        
-                        double inputSum_LSB= 0;      // Reference for LSB cell
-                        for (int k=0; k<param->nInput; k++) {
-							if ((dTestInput[i][k]>>n) & 1) {    // if the nth bit of dTestInput[i][k] is 1
-								Isum_LSB += arrayIH->ReadCell(j,k,"LSB");
-                                Isum_MSB_LTP += arrayIH->ReadCell(j,k,"MSB_LTP");  
-                                Isum_MSB_LTD += arrayIH->ReadCell(j,k,"MSB_LTD");  
-								inputSum_LSB += arrayIH->GetMediumCellReadCurrent(j,k);
-                                sumArrayReadEnergyIH += arrayIH->wireCapRow * readVoltageIH * readVoltageIH;   // Selected BLs (1T1R) or Selected WLs (cross-point)
-                                sumArrayReadEnergyIH += 2*arrayIH->wireCapRow * readVoltageMSB * readVoltageMSB; // Selected BLs (1T1R) or Selected WLs (cross-point)
+							sumArrayReadEnergyIH += Isum * readVoltageIH * readPulseWidthIH;
+							int outputDigits = (CurrentToDigits(Isum, IsumMax-IsumMin)-CurrentToDigits(inputSum, IsumMax-IsumMin));
+	                        //int outputDigits = (CurrentToDigits(Isum, IsumMax)-CurrentToDigits(inputSum, IsumMax));
+							outN1[j] += DigitsToAlgorithm(outputDigits, pSumMaxAlgorithm);
+						} 
+	                    else if(arrayIH->IsHybridCell())
+	                    {
+	                        double Isum_LSB = 0;              // weighted sum current of the LTP cell
+	                        double Isum_MSB_LTP = 0;    // weighted sum current of the LTP cell
+	                        double Isum_MSB_LTD = 0;    // weighted sum current of the LTP cell
+	                        double IsumMax_LSB = 0;            //the maximum weight sum current (all cells are at high conductance)
+	                        double IsumMin_LSB = 0;
+	                        double IsumMax_MSB = 0;
+	                        double IsumMin_MSB = 0;                        
+	                        double inputSum_LSB= 0;      // Reference for LSB cell
+	                        const unsigned short *activeRows = testSet->GetActiveRows(i, n);    // rows whose nth input bit is 1
+	                        int numActiveRows = testSet->GetNumActiveRows(i, n);
+	                        for (int a=0; a<numActiveRows; a++) {
+	                            int k = activeRows[a];
+	                            Isum_LSB += arrayIH->ReadCell(j,k,"LSB");
+	                            Isum_MSB_LTP += arrayIH->ReadCell(j,k,"MSB_LTP");
+	                            Isum_MSB_LTD += arrayIH->ReadCell(j,k,"MSB_LTD");
+	                            inputSum_LSB += arrayIH->GetMediumCellReadCurrent(j,k);
+	                            sumArrayReadEnergyIH += arrayIH->wireCapRow * readVoltageIH * readVoltageIH;   // Selected BLs (1T1R) or Selected WLs (cross-point)
+	                            sumArrayReadEnergyIH += 2*arrayIH->wireCapRow * readVoltageMSB * readVoltageMSB; // Selected BLs (1T1R) or Selected WLs (cross-point)
+	                        }
+	                        for (int k=0; k<param->nInput; k++) {
+								IsumMax_LSB += arrayIH->GetMaxCellReadCurrent(j,k,"LSB");
+	                         	IsumMin_LSB += arrayIH->GetMinCellReadCurrent(j,k,"LSB");
+	                            IsumMax_MSB += arrayIH->GetMaxCellReadCurrent(j,k,"MSB");
+	                            IsumMin_MSB += arrayIH->GetMinCellReadCurrent(j,k,"MSB");
 							}
-							IsumMax_LSB += arrayIH->GetMaxCellReadCurrent(j,k,"LSB");
-                         	IsumMin_LSB += arrayIH->GetMinCellReadCurrent(j,k,"LSB");
-                            IsumMax_MSB += arrayIH->GetMaxCellReadCurrent(j,k,"MSB");
-                            IsumMin_MSB += arrayIH->GetMinCellReadCurrent(j,k,"MSB");
-						}
-                        sumArrayReadEnergyIH += Isum_LSB * readVoltageIH * readPulseWidthIH;
-                        sumArrayReadEnergyIH += (Isum_MSB_LTP + Isum_MSB_LTD) * readVoltageMSB * readPulseWidthMSB;
-                        int outputDigits;
-                        int outputDigitsLSB = 2*(CurrentToDigits(Isum_LSB, IsumMax_LSB-IsumMin_LSB)-CurrentToDigits(inputSum_LSB, IsumMax_LSB-IsumMin_LSB)); //minus the reference
-                        //int outputDigitsLSB = CurrentToDigits(Isum_LSB, IsumMax_LSB-IsumMin_LSB)-CurrentToDigits(inputSum_LSB, IsumMax_LSB-IsumMin_LSB); //minus the reference
-                        int outputDigitsMSB = CurrentToDigits(Isum_MSB_LTP, IsumMax_MSB-IsumMin_MSB)-CurrentToDigits(Isum_MSB_LTD, IsumMax_MSB-IsumMin_MSB); //minus the reference
-                        outputDigits = static_cast<HybridCell*>(arrayIH->cell[0][0])->significance*outputDigitsMSB+outputDigitsLSB;
-                        outN1[j] += DigitsToAlgorithm(outputDigits/3, pSumMaxAlgorithm)/(static_cast<HybridCell*>(arrayIH->cell[0][0])->significance+1);;   
-                    }
-                    else {
-                            bool digitalNVM = false; 
-                            bool parallelRead = false;
-                            if(DigitalNVM*temp = dynamic_cast<DigitalNVM*>(arrayIH->cell[0][0]))
-                            {    digitalNVM = true;
-                                if(static_cast<DigitalNVM*>(arrayIH->cell[0][0])->parallelRead == true) 
-								{
-                                    parallelRead = true;
-                                }
-                            }
-                            if(digitalNVM && parallelRead) // parallel read-out for DigitalNVM
-                            {
-                                    double Imax = static_cast<DigitalNVM*>(arrayIH->cell[0][0])->avgMaxConductance*static_cast<DigitalNVM*>(arrayIH->cell[0][0])->readVoltage;
-                                    double Imin = static_cast<DigitalNVM*>(arrayIH->cell[0][0])->avgMinConductance*static_cast<DigitalNVM*>(arrayIH->cell[0][0])->readVoltage;
-                                    double Isum = 0;    // weighted sum current
-							        double IsumMax = 0; // Max weighted sum current
-							        double inputSum = 0;    // Weighted sum current of input vector * weight=1 column
-                                    int Dsum=0;
-                                    int DsumMax = 0;
-                                    int Dref = 0;
-                                    for (int w=0;w<param->numWeightBit;w++){
-                                        int colIndex = (j+1) * param->numWeightBit - (w+1);  // w=0 is the LSB
-									    for (int k=0; k<param->nInput; k++) 
-                                        {
-										    if((dTestInput[i][k]>>n) & 1){ // accumulate the current along a column
-											    Isum += static_cast<DigitalNVM*>(arrayIH->cell[colIndex ][k])->conductance*static_cast<DigitalNVM*>(arrayIH->cell[colIndex ][k])->readVoltage;
+	                        sumArrayReadEnergyIH += Isum_LSB * readVoltageIH * readPulseWidthIH;
+	                        sumArrayReadEnergyIH += (Isum_MSB_LTP + Isum_MSB_LTD) * readVoltageMSB * readPulseWidthMSB;
+	                        int outputDigits;
+	                        int outputDigitsLSB = 2*(CurrentToDigits(Isum_LSB, IsumMax_LSB-IsumMin_LSB)-CurrentToDigits(inputSum_LSB, IsumMax_LSB-IsumMin_LSB)); //minus the reference
+	                        //int outputDigitsLSB = CurrentToDigits(Isum_LSB, IsumMax_LSB-IsumMin_LSB)-CurrentToDigits(inputSum_LSB, IsumMax_LSB-IsumMin_LSB); //minus the reference
+	                        int outputDigitsMSB = CurrentToDigits(Isum_MSB_LTP, IsumMax_MSB-IsumMin_MSB)-CurrentToDigits(Isum_MSB_LTD, IsumMax_MSB-IsumMin_MSB); //minus the reference
+	                        outputDigits = static_cast<HybridCell*>(arrayIH->cell[0][0])->significance*outputDigitsMSB+outputDigitsLSB;
+	                        outN1[j] += DigitsToAlgorithm(outputDigits/3, pSumMaxAlgorithm)/(static_cast<HybridCell*>(arrayIH->cell[0][0])->significance+1);;   
+	                    }
+	                    else {
+	                            bool digitalNVM = false; 
+	                            bool parallelRead = false;
+	                            if(arrayIH->IsDigitalNVM())
+	                            {    digitalNVM = true;
+	                                if(static_cast<DigitalNVM*>(arrayIH->cell[0][0])->parallelRead == true) 
+									{
+	                                    parallelRead = true;
+	                                }
+	                            }
+	                            if(digitalNVM && parallelRead) // parallel read-out for DigitalNVM
+	                            {
+	                                    double Imax = static_cast<DigitalNVM*>(arrayIH->cell[0][0])->avgMaxConductance*static_cast<DigitalNVM*>(arrayIH->cell[0][0])->readVoltage;
+	                                    double Imin = static_cast<DigitalNVM*>(arrayIH->cell[0][0])->avgMinConductance*static_cast<DigitalNVM*>(arrayIH->cell[0][0])->readVoltage;
+	                                    double Isum = 0;    // weighted sum current
+								        double IsumMax = 0; // Max weighted sum current
+								        double inputSum = 0;    // Weighted sum current of input vector * weight=1 column
+	                                    int Dsum=0;
+	                                    int DsumMax = 0;
+	                                    int Dref = 0;
+	                                    for (int w=0;w<param->numWeightBit;w++){
+	                                        int colIndex = (j+1) * param->numWeightBit - (w+1);  // w=0 is the LSB
+										    const unsigned short *activeRows = testSet->GetActiveRows(i, n);    // accumulate the current along a column
+										    int numActiveRows = testSet->GetNumActiveRows(i, n);
+										    for (int a=0; a<numActiveRows; a++)
+	                                        {
+											    int k = activeRows[a];
+											    Isum += arrayIH->conductance[arrayIH->CellIndex(colIndex, k)]*static_cast<DigitalNVM*>(arrayIH->cell[colIndex ][k])->readVoltage;
 											    //inputSum += Imin;
-                                                inputSum += static_cast<DigitalNVM*>(arrayIH->cell[arrayIH->refColumnNumber][k])->conductance*static_cast<DigitalNVM*>(arrayIH->cell[arrayIH->refColumnNumber][k])->readVoltage;
+	                                            inputSum += arrayIH->conductance[arrayIH->CellIndex(arrayIH->refColumnNumber, k)]*static_cast<DigitalNVM*>(arrayIH->cell[arrayIH->refColumnNumber][k])->readVoltage;
 										    }
-									    }
-                                       /* int outputDigits = (Isum - inputSum)/(Imax-Imin); // the output at the ADC of this column
-                                                                                                               // basically, this is the number of "1" in this column
-                                        if(outputDigits > param->pSumMaxHardware)
-                                            outputDigits = param->pSumMaxHardware; */
-                                        int outputDigits = (int) (Isum /(Imax-Imin)); // the output at the ADC of this column
-                                                                                                               // basically, this is the number of "1" in this column
-                                        int outputDigitsRef = (int) (inputSum/(Imax-Imin));
+	                                       /* int outputDigits = (Isum - inputSum)/(Imax-Imin); // the output at the ADC of this column
+	                                                                                                               // basically, this is the number of "1" in this column
+	                                        if(outputDigits > param->pSumMaxHardware)
+	                                            outputDigits = param->pSumMaxHardware; */
+	                                        int outputDigits = (int) (Isum /(Imax-Imin)); // the output at the ADC of this column
+	                                                                                                               // basically, this is the number of "1" in this column
+	                                        int outputDigitsRef = (int) (inputSum/(Imax-Imin));
                                     
-                                        if(outputDigits > param->pSumMaxHardware)
-                                            outputDigits = param->pSumMaxHardware;
-                                        if(outputDigitsRef > param->pSumMaxHardware)
-                                            outputDigitsRef = param->pSumMaxHardware;
-                                        outputDigits = outputDigits-outputDigitsRef;
+	                                        if(outputDigits > param->pSumMaxHardware)
+	                                            outputDigits = param->pSumMaxHardware;
+	                                        if(outputDigitsRef > param->pSumMaxHardware)
+	                                            outputDigitsRef = param->pSumMaxHardware;
+	                                        outputDigits = outputDigits-outputDigitsRef;
                                             
-                                        Dref = (int)(inputSum/Imin);
-                                        Isum=0;
-                                        inputSum=0;
-                                        Dsum += outputDigits*(int) pow(2,w);  // get the weight represented by the column
-                                        DsumMax += param->nInput*(int) pow(2,w); // the maximum weight that can be represented by this column
+	                                        Dref = (int)(inputSum/Imin);
+	                                        Isum=0;
+	                                        inputSum=0;
+	                                        Dsum += outputDigits*(int) pow(2,w);  // get the weight represented by the column
+	                                        DsumMax += param->nInput*(int) pow(2,w); // the maximum weight that can be represented by this column
         
-                                    }
-                                    outN1[j] += (double)(Dsum - Dref*(pow(2,param->numWeightBit-1)-1)) / DsumMax * pSumMaxAlgorithm;
-                                    sumArrayReadEnergyIH  += static_cast<DigitalNVM*>(arrayIH->cell[0][0])->readEnergy * arrayIH->numCellPerSynapse * arrayIH->arrayRowSize;
-                            }
-                            else
-                            {	 // Digital NVM or SRAM row-by-row readout				
-							    int Dsum = 0;
-							    int DsumMax = 0;
-							    int inputSum = 0;
-							    for (int k=0; k<param->nInput; k++) {
-								    if ((dTestInput[i][k]>>n) & 1) {    // if the nth bit of dInput[i][k] is 1
+	                                    }
+	                                    outN1[j] += (double)(Dsum - Dref*(pow(2,param->numWeightBit-1)-1)) / DsumMax * pSumMaxAlgorithm;
+	                                    sumArrayReadEnergyIH  += static_cast<DigitalNVM*>(arrayIH->cell[0][0])->readEnergy * arrayIH->numCellPerSynapse * arrayIH->arrayRowSize;
+	                            }
+	                            else
+	                            {	 // Digital NVM or SRAM row-by-row readout				
+								    int Dsum = 0;
+								    int DsumMax = 0;
+								    int inputSum = 0;
+								    const unsigned short *activeRows = testSet->GetActiveRows(i, n);    // rows whose nth input bit is 1
+								    int numActiveRows = testSet->GetNumActiveRows(i, n);
+								    for (int a=0; a<numActiveRows; a++) {
+									    int k = activeRows[a];
 									    Dsum += (int)(arrayIH->ReadCell(j,k));
 									    inputSum += pow(2, arrayIH->numCellPerSynapse-1) - 1;   // get the digital weights of the dummy column as reference
 								    }
-								    DsumMax += pow(2, arrayIH->numCellPerSynapse) - 1;
-							    }
-							    if (DigitalNVM *temp = dynamic_cast<DigitalNVM*>(arrayIH->cell[0][0])) {    // Digital eNVM
-								    sumArrayReadEnergyIH  += static_cast<DigitalNVM*>(arrayIH->cell[0][0])->readEnergy * arrayIH->numCellPerSynapse * arrayIH->arrayRowSize;
-							    } 
-                                else {    // SRAM
-								    sumArrayReadEnergyIH  += static_cast<SRAM*>(arrayIH->cell[0][0])->readEnergy * arrayIH->numCellPerSynapse * arrayIH->arrayRowSize;
-							    }
-							    outN1[j] += (double)(Dsum - inputSum) / DsumMax * pSumMaxAlgorithm;
-							}
-                    }
-                }
-				a1[j] = sigmoid(outN1[j]);
-				//da1[j] = round(a1[j] * (param->numInputLevel - 1));
-				da1[j] = round_th(a1[j]*(param->numInputLevel-1), param->Hthreshold);
+								    for (int k=0; k<param->nInput; k++) {
+									    DsumMax += pow(2, arrayIH->numCellPerSynapse) - 1;
+								    }
+								    if (arrayIH->IsDigitalNVM()) {    // Digital eNVM
+									    sumArrayReadEnergyIH  += static_cast<DigitalNVM*>(arrayIH->cell[0][0])->readEnergy * arrayIH->numCellPerSynapse * arrayIH->arrayRowSize;
+								    } 
+	                                else {    // SRAM
+									    sumArrayReadEnergyIH  += static_cast<SRAM*>(arrayIH->cell[0][0])->readEnergy * arrayIH->numCellPerSynapse * arrayIH->arrayRowSize;
+								    }
+								    outN1[j] += (double)(Dsum - inputSum) / DsumMax * pSumMaxAlgorithm;
+								}
+	                    }
+	                }
+					a1[j] = sigmoid(outN1[j]);
+					//da1[j] = round(a1[j] * (param->numInputLevel - 1));
+					da1[j] = round_th(a1[j]*(param->numInputLevel-1), param->Hthreshold);
+				}
 			}
+			da1Rows.Build(da1);
 
 			numBatchReadSynapse = (int)ceil((double)param->nHide/param->numColMuxed);
 			#pragma omp critical    // Use critical here since NeuroSim class functions may update its member variables
 			for (int j=0; j<param->nHide; j+=numBatchReadSynapse) {
-				int numActiveRows = 0;  // Number of selected rows for NeuroSim
-				for (int n=0; n<param->numBitInput; n++) {
-					for (int k=0; k<param->nInput; k++) {
-						if ((dTestInput[i][k]>>n) & 1) {    // if the nth bit of dTestInput[i][k] is 1
-							numActiveRows++;
-						}
-					}
-				}
+				int numActiveRows = testSet->GetNumActiveRows(i);  // Number of selected rows for NeuroSim
 				subArrayIH->activityRowRead = (double)numActiveRows/param->nInput/param->numBitInput;
 				sumNeuroSimReadEnergyIH += NeuroSimSubArrayReadEnergy(subArrayIH);
 				sumNeuroSimReadEnergyIH += NeuroSimNeuronReadEnergy(subArrayIH, adderIH, muxIH, muxDecoderIH, dffIH, subtractorIH);
@@ -290,7 +334,7 @@ void Validate() {
 		} else {    // Algorithm
 			for (int j=0; j<param->nHide; j++){
 				for (int k=0; k<param->nInput; k++){
-					outN1[j] += testInput[i][k] * weight1[j][k];
+					outN1[j] += testSet->GetInput(i, k) * weight1[j][k];
 				}
 				a1[j] = sigmoid(outN1[j]);
 			}
@@ -302,164 +346,183 @@ void Validate() {
 		std::fill_n(outN2, param->nOutput, 0);
 		std::fill_n(a2, param->nOutput, 0);
 		if (param->useHardwareInTestingFF) {  // Hardware
-			for (int j=0; j<param->nOutput; j++) {
-				if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(arrayHO->cell[0][0])) {  // Analog eNVM
-					if (static_cast<eNVM*>(arrayHO->cell[0][0])->cmosAccess) {  // 1T1R
-						sumArrayReadEnergyHO += arrayHO->wireGateCapRow * techHO.vdd * techHO.vdd * param->nHide; // All WLs open
-					}
-				} else if (DigitalNVM *temp = dynamic_cast<DigitalNVM*>(arrayHO->cell[0][0])) {
-					if (static_cast<eNVM*>(arrayHO->cell[0][0])->cmosAccess) {  // 1T1R
-						sumArrayReadEnergyHO += arrayHO->wireGateCapRow * techHO.vdd * techHO.vdd;  // Selected WL
-					} else {    // Cross-point
-						sumArrayReadEnergyHO += arrayHO->wireCapRow * techHO.vdd * techHO.vdd * (param->nHide - 1); // Unselected WLs
+			if (arrayHO->IsAnalogNVM() && arrayHO->cachedReadCurrent) {	// Analog eNVM, all columns read at once
+				if (static_cast<eNVM*>(arrayHO->cell[0][0])->cmosAccess) {  // 1T1R
+					sumArrayReadEnergyHO += arrayHO->wireGateCapRow * techHO.vdd * techHO.vdd * param->nHide * param->nOutput; // All WLs open
+				}
+				const unsigned short *activeRows[param->numBitInput];
+				int numActiveRows[param->numBitInput];
+				for (int n=0; n<param->numBitInput; n++) {
+					activeRows[n] = da1Rows.GetActiveRows(n);
+					numActiveRows[n] = da1Rows.GetNumActiveRows(n);
+				}
+				AnalogLayerForward(arrayHO, param->nOutput, activeRows, numActiveRows, outN2, a2, NULL, sumArrayReadEnergyHO);
+				for (int j=0; j<param->nOutput; j++) {
+					if (a2[j] > tempMax) {
+						tempMax = a2[j];
+						countNum = j;
 					}
-				}else if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(arrayHO->cell[0][0]))  // Analog eNVM
-						sumArrayReadEnergyHO += arrayHO->wireGateCapRow * techHO.vdd * techHO.vdd * param->nHide; // All WLs open
+				}
+			} else {
+				for (int j=0; j<param->nOutput; j++) {
+					if (arrayHO->IsAnalogNVM()) {  // Analog eNVM
+						if (static_cast<eNVM*>(arrayHO->cell[0][0])->cmosAccess) {  // 1T1R
+							sumArrayReadEnergyHO += arrayHO->wireGateCapRow * techHO.vdd * techHO.vdd * param->nHide; // All WLs open
+						}
+					} else if (arrayHO->IsDigitalNVM()) {
+						if (static_cast<eNVM*>(arrayHO->cell[0][0])->cmosAccess) {  // 1T1R
+							sumArrayReadEnergyHO += arrayHO->wireGateCapRow * techHO.vdd * techHO.vdd;  // Selected WL
+						} else {    // Cross-point
+							sumArrayReadEnergyHO += arrayHO->wireCapRow * techHO.vdd * techHO.vdd * (param->nHide - 1); // Unselected WLs
+						}
+					}else if (arrayHO->IsAnalogNVM())  // Analog eNVM
+							sumArrayReadEnergyHO += arrayHO->wireGateCapRow * techHO.vdd * techHO.vdd * param->nHide; // All WLs open
 
-				for (int n=0; n<param->numBitInput; n++) {
-					double pSumMaxAlgorithm = pow(2, n) / (param->numInputLevel - 1) * arrayHO->arrayRowSize;    // Max algorithm partial weighted sum for the nth vector bit (if both max input value and max weight are 1)
-					if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(arrayHO->cell[0][0])) {  // Analog NVM
-						double Isum = 0;    // weighted sum current
-						double IsumMax = 0; // Max weighted sum current
-                        double IsumMin = 0;
-						double a1Sum = 0;   // Weighted sum current of a1 vector * weight=1 column
-						for (int k=0; k<param->nHide; k++) {
-							if ((da1[k]>>n) & 1) {    // if the nth bit of da1[k] is 1
+					for (int n=0; n<param->numBitInput; n++) {
+						randomPhase.step = n;	// Read noise of this bit plane
+						double pSumMaxAlgorithm = pow(2, n) / (param->numInputLevel - 1) * arrayHO->arrayRowSize;    // Max algorithm partial weighted sum for the nth vector bit (if both max input value and max weight are 1)
+						if (arrayHO->IsAnalogNVM()) {  // Analog NVM
+							double Isum = 0;    // weighted sum current
+							double IsumMax = arrayHO->columnMaxReadCurrent[j]; // Max weighted sum current (cached per column)
+							double IsumMin = arrayHO->columnMinReadCurrent[j];
+							double a1Sum = 0;   // Weighted sum current of a1 vector * weight=1 column
+							const unsigned short *activeRows = da1Rows.GetActiveRows(n);    // rows whose nth bit of da1 is 1
+							int numActiveRows = da1Rows.GetNumActiveRows(n);
+							for (int a=0; a<numActiveRows; a++) {
+								int k = activeRows[a];
 								Isum += arrayHO->ReadCell(j,k);
-								a1Sum += arrayHO->GetMediumCellReadCurrent(j,k);
-								sumArrayReadEnergyHO += arrayHO->wireCapRow * readVoltageHO * readVoltageHO;  
+								a1Sum += arrayHO->mediumReadCurrent[arrayHO->CellIndex(j, k)];
+								sumArrayReadEnergyHO += arrayHO->wireCapRow * readVoltageHO * readVoltageHO;
 							}
-							IsumMax += arrayHO->GetMaxCellReadCurrent(j,k);
-                            IsumMin += arrayHO->GetMinCellReadCurrent(j,k);
-						}
-						sumArrayReadEnergyHO += Isum * readVoltageHO * readPulseWidthHO;
-						int outputDigits = (CurrentToDigits(Isum, IsumMax-IsumMin)-CurrentToDigits(a1Sum, IsumMax-IsumMin));
-						//int outputDigits = (CurrentToDigits(Isum, IsumMax)-CurrentToDigits(a1Sum, IsumMax));
-						outN2[j] += DigitsToAlgorithm(outputDigits, pSumMaxAlgorithm);
+							sumArrayReadEnergyHO += Isum * readVoltageHO * readPulseWidthHO;
+							int outputDigits = (CurrentToDigits(Isum, IsumMax-IsumMin)-CurrentToDigits(a1Sum, IsumMax-IsumMin));
+							//int outputDigits = (CurrentToDigits(Isum, IsumMax)-CurrentToDigits(a1Sum, IsumMax));
+							outN2[j] += DigitsToAlgorithm(outputDigits, pSumMaxAlgorithm);
                         
-					} else if	(HybridCell *temp = dynamic_cast<HybridCell*>(arrayHO->cell[0][0])) {  //3T1C
+						} else if	(arrayHO->IsHybridCell()) {  //3T1C
                        
-                        double Isum_LSB = 0;              // weighted sum current of the LTP cell
-                        double Isum_MSB_LTP = 0;    // weighted sum current of the LTP cell
-                        double Isum_MSB_LTD = 0;    // weighted sum current of the LTP cell
-                        double IsumMax_LSB = 0;            //the maximum weight sum current (all cells are at high conductance)
-                        double IsumMin_LSB = 0;
-                        double IsumMax_MSB = 0; 
-                        double IsumMin_MSB = 0;                         
-                        double a1Sum_LSB= 0;      // Reference for LSB cell
-						for (int k=0; k<param->nHide; k++) {
-							if ((da1[k]>>n) & 1) {    // if the nth bit of da1[k] is 1
-                                Isum_LSB += arrayHO->ReadCell(j,k,"LSB");                   // the weight sum of the Jth column
-                                Isum_MSB_LTP += arrayHO->ReadCell(j,k,"MSB_LTP");  
-                                Isum_MSB_LTD += arrayHO->ReadCell(j,k,"MSB_LTD");  
-                                a1Sum_LSB += arrayHO->GetMediumCellReadCurrent(j,k);
-                                sumArrayReadEnergyHO += arrayHO->wireCapRow * readVoltageHO * readVoltageHO; // Selected BLs (1T1R) or Selected WLs (cross-point)
-                                sumArrayReadEnergyHO += 2*arrayHO->wireCapRow * readVoltageMSB * readVoltageMSB; // Selected BLs (1T1R) or Selected WLs (cross-point)
+	                        double Isum_LSB = 0;              // weighted sum current of the LTP cell
+	                        double Isum_MSB_LTP = 0;    // weighted sum current of the LTP cell
+	                        double Isum_MSB_LTD = 0;    // weighted sum current of the LTP cell
+	                        double IsumMax_LSB = 0;            //the maximum weight sum current (all cells are at high conductance)
+	                        double IsumMin_LSB = 0;
+	                        double IsumMax_MSB = 0; 
+	                        double IsumMin_MSB = 0;                         
+	                        double a1Sum_LSB= 0;      // Reference for LSB cell
+							const unsigned short *activeRows = da1Rows.GetActiveRows(n);    // rows whose nth bit of da1 is 1
+							int numActiveRows = da1Rows.GetNumActiveRows(n);
+							for (int a=0; a<numActiveRows; a++) {
+	                            int k = activeRows[a];
+	                            Isum_LSB += arrayHO->ReadCell(j,k,"LSB");                   // the weight sum of the Jth column
+	                            Isum_MSB_LTP += arrayHO->ReadCell(j,k,"MSB_LTP");
+	                            Isum_MSB_LTD += arrayHO->ReadCell(j,k,"MSB_LTD");
+	                            a1Sum_LSB += arrayHO->GetMediumCellReadCurrent(j,k);
+	                            sumArrayReadEnergyHO += arrayHO->wireCapRow * readVoltageHO * readVoltageHO; // Selected BLs (1T1R) or Selected WLs (cross-point)
+	                            sumArrayReadEnergyHO += 2*arrayHO->wireCapRow * readVoltageMSB * readVoltageMSB; // Selected BLs (1T1R) or Selected WLs (cross-point)
 							}
-                            IsumMax_LSB += arrayHO->GetMaxCellReadCurrent(j,k,"LSB");
-                            IsumMax_MSB += arrayHO->GetMaxCellReadCurrent(j,k,"MSB");
-                            IsumMin_LSB += arrayHO->GetMinCellReadCurrent(j,k,"LSB");
-                            IsumMin_MSB += arrayHO->GetMinCellReadCurrent(j,k,"MSB");
-						}                        
-                        sumArrayReadEnergyHO += Isum_LSB * readVoltageHO * readPulseWidthHO;
-                        sumArrayReadEnergyHO += (Isum_MSB_LTP + Isum_MSB_LTD) * readVoltageMSB * readPulseWidthMSB;
-                        int outputDigits;
-                        int outputDigitsLSB = 2*(CurrentToDigits(Isum_LSB, IsumMax_LSB-IsumMin_LSB)-CurrentToDigits(a1Sum_LSB, IsumMax_LSB-IsumMin_LSB)); //minus the reference
-                        //int outputDigitsLSB = CurrentToDigits(Isum_LSB, IsumMax_LSB-IsumMin_LSB)-CurrentToDigits(a1Sum_LSB, IsumMax_LSB-IsumMin_LSB); //minus the reference
-                        int outputDigitsMSB = CurrentToDigits(Isum_MSB_LTP, IsumMax_MSB-IsumMin_MSB)-CurrentToDigits(Isum_MSB_LTD, IsumMax_MSB-IsumMin_MSB); //minus the reference
-                        outputDigits = static_cast<HybridCell*>(arrayHO->cell[0][0])->significance*outputDigitsMSB+outputDigitsLSB;
-                        outN2[j] += DigitsToAlgorithm(outputDigits, pSumMaxAlgorithm)/(static_cast<HybridCell*>(arrayIH->cell[0][0])->significance+1);; 
-					} 
-                    else 
-                        {// SRAM or digital eNVM
-                            bool digitalNVM = false; 
-                            bool parallelRead = false;
-                            if(DigitalNVM*temp = dynamic_cast<DigitalNVM*>(arrayHO->cell[0][0]))
-                            {    digitalNVM = true;
-                                if(static_cast<DigitalNVM*>(arrayHO->cell[0][0])->parallelRead == true) 
-								{
-                                    parallelRead = true;
-                                }
-                            }
-                            if(digitalNVM && parallelRead)
-                            {
-                                //printf("Calculating the weight for parallel read-out\n");
-                                double Imin = static_cast<DigitalNVM*>(arrayHO->cell[0][0])->avgMinConductance*static_cast<DigitalNVM*>(arrayHO->cell[0][0])->readVoltage;
-                                double Imax = static_cast<DigitalNVM*>(arrayHO->cell[0][0])->avgMaxConductance*static_cast<DigitalNVM*>(arrayHO->cell[0][0])->readVoltage;
-                                double Isum = 0;    // weighted sum current
-                                double IsumMax = 0; // Max weighted sum current
-                                double inputSum = 0;    // Weighted sum current of input vector * weight=1 column
-                                int Dsum=0;
-                                int DsumMax = 0;
-                                int Dref = 0;
-                                for (int w=0;w<param->numWeightBit;w++){
-                                    int colIndex = (j+1) * param->numWeightBit - (w+1);  // w=0 is the LSB
-                                    for (int k=0; k<param->nHide; k++) {
-                                        if ((da1[k]>>n) & 1) { // accumulate the current along a column
-                                            Isum += static_cast<DigitalNVM*>(arrayHO->cell[colIndex][k])->conductance*static_cast<DigitalNVM*>(arrayHO->cell[colIndex][k])->readVoltage;
-                                            //inputSum += Imin;
-                                            inputSum += static_cast<DigitalNVM*>(arrayHO->cell[arrayHO->refColumnNumber][k])->conductance*static_cast<DigitalNVM*>(arrayHO->cell[arrayHO->refColumnNumber][k])->readVoltage;                                            
-                                        }
-                                    }
-                                    int outputDigits = (int) (Isum /(Imax-Imin)); // the output at the ADC of this column
-                                                                                                               // basically, this is the number of "1" in this column
-                                    int outputDigitsRef = (int) (inputSum/(Imax-Imin));
+							for (int k=0; k<param->nHide; k++) {
+	                            IsumMax_LSB += arrayHO->GetMaxCellReadCurrent(j,k,"LSB");
+	                            IsumMax_MSB += arrayHO->GetMaxCellReadCurrent(j,k,"MSB");
+	                            IsumMin_LSB += arrayHO->GetMinCellReadCurrent(j,k,"LSB");
+	                            IsumMin_MSB += arrayHO->GetMinCellReadCurrent(j,k,"MSB");
+							}                        
+	                        sumArrayReadEnergyHO += Isum_LSB * readVoltageHO * readPulseWidthHO;
+	                        sumArrayReadEnergyHO += (Isum_MSB_LTP + Isum_MSB_LTD) * readVoltageMSB * readPulseWidthMSB;
+	                        int outputDigits;
+	                        int outputDigitsLSB = 2*(CurrentToDigits(Isum_LSB, IsumMax_LSB-IsumMin_LSB)-CurrentToDigits(a1Sum_LSB, IsumMax_LSB-IsumMin_LSB)); //minus the reference
+	                        //int outputDigitsLSB = CurrentToDigits(Isum_LSB, IsumMax_LSB-IsumMin_LSB)-CurrentToDigits(a1Sum_LSB, IsumMax_LSB-IsumMin_LSB); //minus the reference
+	                        int outputDigitsMSB = CurrentToDigits(Isum_MSB_LTP, IsumMax_MSB-IsumMin_MSB)-CurrentToDigits(Isum_MSB_LTD, IsumMax_MSB-IsumMin_MSB); //minus the reference
+	                        outputDigits = static_cast<HybridCell*>(arrayHO->cell[0][0])->significance*outputDigitsMSB+outputDigitsLSB;
+	                        outN2[j] += DigitsToAlgorithm(outputDigits, pSumMaxAlgorithm)/(static_cast<HybridCell*>(arrayIH->cell[0][0])->significance+1);; 
+						} 
+	                    else 
+	                        {// SRAM or digital eNVM
+	                            bool digitalNVM = false; 
+	                            bool parallelRead = false;
+	                            if(arrayHO->IsDigitalNVM())
+	                            {    digitalNVM = true;
+	                                if(static_cast<DigitalNVM*>(arrayHO->cell[0][0])->parallelRead == true) 
+									{
+	                                    parallelRead = true;
+	                                }
+	                            }
+	                            if(digitalNVM && parallelRead)
+	                            {
+	                                //printf("Calculating the weight for parallel read-out\n");
+	                                double Imin = static_cast<DigitalNVM*>(arrayHO->cell[0][0])->avgMinConductance*static_cast<DigitalNVM*>(arrayHO->cell[0][0])->readVoltage;
+	                                double Imax = static_cast<DigitalNVM*>(arrayHO->cell[0][0])->avgMaxConductance*static_cast<DigitalNVM*>(arrayHO->cell[0][0])->readVoltage;
+	                                double Isum = 0;    // weighted sum current
+	                                double IsumMax = 0; // Max weighted sum current
+	                                double inputSum = 0;    // Weighted sum current of input vector * weight=1 column
+	                                int Dsum=0;
+	                                int DsumMax = 0;
+	                                int Dref = 0;
+	                                for (int w=0;w<param->numWeightBit;w++){
+	                                    int colIndex = (j+1) * param->numWeightBit - (w+1);  // w=0 is the LSB
+	                                    const unsigned short *activeRows = da1Rows.GetActiveRows(n);    // accumulate the current along a column
+	                                    int numActiveRows = da1Rows.GetNumActiveRows(n);
+	                                    for (int a=0; a<numActiveRows; a++) {
+	                                        int k = activeRows[a];
+	                                        Isum += arrayHO->conductance[arrayHO->CellIndex(colIndex, k)]*static_cast<DigitalNVM*>(arrayHO->cell[colIndex][k])->readVoltage;
+	                                        //inputSum += Imin;
+	                                        inputSum += arrayHO->conductance[arrayHO->CellIndex(arrayHO->refColumnNumber, k)]*static_cast<DigitalNVM*>(arrayHO->cell[arrayHO->refColumnNumber][k])->readVoltage;
+	                                    }
+	                                    int outputDigits = (int) (Isum /(Imax-Imin)); // the output at the ADC of this column
+	                                                                                                               // basically, this is the number of "1" in this column
+	                                    int outputDigitsRef = (int) (inputSum/(Imax-Imin));
                                     
-                                    if(outputDigits > param->pSumMaxHardware)
-                                        outputDigits = param->pSumMaxHardware;
-                                    if(outputDigitsRef > param->pSumMaxHardware)
-                                        outputDigitsRef = param->pSumMaxHardware;
-                                    outputDigits = outputDigits-outputDigitsRef;
+	                                    if(outputDigits > param->pSumMaxHardware)
+	                                        outputDigits = param->pSumMaxHardware;
+	                                    if(outputDigitsRef > param->pSumMaxHardware)
+	                                        outputDigitsRef = param->pSumMaxHardware;
+	                                    outputDigits = outputDigits-outputDigitsRef;
  
-                                    Dref = (int)(inputSum/Imin);
-                                    Isum=0;
-                                    inputSum=0;
-                                    Dsum += outputDigits*(int) pow(2,w);  // get the weight represented by the column
-                                    DsumMax += param->nHide*(int) pow(2,w); // the maximum weight that can be represented by this column                                        
-                                }
-                                sumArrayReadEnergyHO += static_cast<DigitalNVM*>(arrayHO->cell[0][0])->readEnergy * arrayHO->numCellPerSynapse * arrayHO->arrayRowSize;
-                                outN2[j] += (double)(Dsum - Dref*(pow(2,param->numWeightBit-1)-1)) / DsumMax * pSumMaxAlgorithm;
-                            }
-                            else
-                            {                            
-							    int Dsum = 0;
-							    int DsumMax = 0;
-							    int a1Sum = 0;
-							    for (int k=0; k<param->nHide; k++) {
-								    if ((da1[k]>>n) & 1) {    // if the nth bit of da1[k] is 1
+	                                    Dref = (int)(inputSum/Imin);
+	                                    Isum=0;
+	                                    inputSum=0;
+	                                    Dsum += outputDigits*(int) pow(2,w);  // get the weight represented by the column
+	                                    DsumMax += param->nHide*(int) pow(2,w); // the maximum weight that can be represented by this column                                        
+	                                }
+	                                sumArrayReadEnergyHO += static_cast<DigitalNVM*>(arrayHO->cell[0][0])->readEnergy * arrayHO->numCellPerSynapse * arrayHO->arrayRowSize;
+	                                outN2[j] += (double)(Dsum - Dref*(pow(2,param->numWeightBit-1)-1)) / DsumMax * pSumMaxAlgorithm;
+	                            }
+	                            else
+	                            {                            
+								    int Dsum = 0;
+								    int DsumMax = 0;
+								    int a1Sum = 0;
+								    const unsigned short *activeRows = da1Rows.GetActiveRows(n);    // rows whose nth bit of da1 is 1
+								    int numActiveRows = da1Rows.GetNumActiveRows(n);
+								    for (int a=0; a<numActiveRows; a++) {
+									    int k = activeRows[a];
 									    Dsum += (int)(arrayHO->ReadCell(j,k));
 									    a1Sum += pow(2, arrayHO->numCellPerSynapse-1) - 1;    // get current of Dummy Column as reference
 								    }
-								    DsumMax += pow(2, arrayHO->numCellPerSynapse) - 1;
-							    } 
-							    if (DigitalNVM *temp = dynamic_cast<DigitalNVM*>(arrayHO->cell[0][0])) {    // Digital eNVM
-								    sumArrayReadEnergyHO += static_cast<DigitalNVM*>(arrayHO->cell[0][0])->readEnergy * arrayHO->numCellPerSynapse * arrayHO->arrayRowSize;
-							    } 
-                                else {
-								    sumArrayReadEnergyHO += static_cast<SRAM*>(arrayHO->cell[0][0])->readEnergy * arrayHO->numCellPerSynapse * arrayHO->arrayRowSize;
-							    }
-							    outN2[j] += (double)(Dsum - a1Sum) / DsumMax * pSumMaxAlgorithm;
-                            }
-						} 
-				}
-				a2[j] = sigmoid(outN2[j]);
-				if (a2[j] > tempMax) {
-					tempMax = a2[j];
-					countNum = j;
+								    for (int k=0; k<param->nHide; k++) {
+									    DsumMax += pow(2, arrayHO->numCellPerSynapse) - 1;
+								    }
+								    if (arrayHO->IsDigitalNVM()) {    // Digital eNVM
+									    sumArrayReadEnergyHO += static_cast<DigitalNVM*>(arrayHO->cell[0][0])->readEnergy * arrayHO->numCellPerSynapse * arrayHO->arrayRowSize;
+								    } 
+	                                else {
+									    sumArrayReadEnergyHO += static_cast<SRAM*>(arrayHO->cell[0][0])->readEnergy * arrayHO->numCellPerSynapse * arrayHO->arrayRowSize;
+								    }
+								    outN2[j] += (double)(Dsum - a1Sum) / DsumMax * pSumMaxAlgorithm;
+	                            }
+							} 
+					}
+					a2[j] = sigmoid(outN2[j]);
+					if (a2[j] > tempMax) {
+						tempMax = a2[j];
+						countNum = j;
+					}
 				}
 			}
 
 			numBatchReadSynapse = (int)ceil((double)param->nOutput/param->numColMuxed);
 			#pragma omp critical    // Use critical here since NeuroSim class functions may update its member variables
 			for (int j=0; j<param->nOutput; j+=numBatchReadSynapse) {
-				int numActiveRows = 0;  // Number of selected rows for NeuroSim
-				for (int n=0; n<param->numBitInput; n++) {
-					for (int k=0; k<param->nHide; k++) {
-						if ((da1[k]>>n) & 1) {    // if the nth bit of da1[k] is 1
-							numActiveRows++;
-						}
-					}
-				}
+				int numActiveRows = da1Rows.GetNumActiveRows();  // Number of selected rows for NeuroSim
 				subArrayHO->activityRowRead = (double)numActiveRows/param->nHide/param->numBitInput;
 				sumNeuroSimReadEnergyHO += NeuroSimSubArrayReadEnergy(subArrayHO);
 				sumNeuroSimReadEnergyHO += NeuroSimNeuronReadEnergy(subArrayHO, adderHO, muxHO, muxDecoderHO, dffHO, subtractorHO);
@@ -478,7 +541,7 @@ void Validate() {
 				}
 			}
 		}
-		if (testOutput[i][countNum] == 1) {
+		if (testSet->GetLabel(i) == countNum) {
 			correct++;
 		}
 	}
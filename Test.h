@@ -40,5 +40,6 @@
 #define TEST_H_
 
 void Validate();
+double TrainingLoss(int numImages);
 
 #endif
@@ -40,6 +40,7 @@
 #include <iostream>
 #include <vector>
 #include <random>
+#include <algorithm>
 #include <string>
 #include <cmath>
 #include "formula.h"
@@ -47,12 +48,20 @@
 #include "Array.h"
 #include "Mapping.h"
 #include "NeuroSim.h"
+#include "Dataset.h"
+#include "Crossbar.h"
+#include "RNG.h"
+#include "PulseTrain.h"
+#include "Workspace.h"
+#include "Optimizer.h"
+#include "Replica.h"
+#include "NetworkShape.h"
+#include "Ledger.h"
+#include "omp.h"
 
 extern Param *param;
 
-extern std::vector< std::vector<double> > Input;
-extern std::vector< std::vector<int> > dInput;
-extern std::vector< std::vector<double> > Output;
+extern Dataset *trainSet;
 
 extern std::vector< std::vector<double> > weight1;
 extern std::vector< std::vector<double> > weight2;
@@ -63,12 +72,9 @@ extern std::vector< std::vector<double> >  totalDeltaWeight1_abs;
 extern std::vector< std::vector<double> >  totalDeltaWeight2;
 extern std::vector< std::vector<double> >  totalDeltaWeight2_abs;
 
-extern std::vector< std::vector<double> >  gradSquarePrev1;
-extern std::vector< std::vector<double> >  gradSquarePrev2;
-extern std::vector< std::vector<double> >  momentumPrev1;
-extern std::vector< std::vector<double> >  momentumPrev2;
-extern std::vector< std::vector<double> >  gradSum1;
-extern std::vector< std::vector<double> >  gradSum2;
+extern Optimizer *optimizerIH;
+extern Optimizer *optimizerHO;
+extern ReplicaGroup *replicas;
 
 
 extern Technology techIH;
@@ -88,964 +94,1254 @@ extern RowDecoder muxDecoderHO;
 extern DFF dffHO;
 extern Subtractor subtractorHO;
 
+extern double trainTimePerSample;
+
 extern double totalWeightUpdate=0; // track the total weight update (absolute value) during the whole training process
 extern double totalNumPulse=0;// track the total number of pulse for the weight update process; for Analog device only
 
-/*Optimization functions*/
-double gradt;
-double GAMA=0.3;
-double BETA1= 0.9, BETA2=0.9; 
-double SGD(double gradient, double learning_rate);
-double Momentum(double gradient, double learning_rate, double momentumPrev, double GAMA=0.3);
-double Adagrad(double gradient, double learning_rate, double gradSquare, double EPSILON=1E-2);
-double RMSprop(double gradient, double learning_rate, double gradSquarePrev,double GAMA=0.9, double EPSILON=1E-5);
-double Adam(double gradient, double learning_rate, double momentumPreV, double velocityPrev, double epoch,double BETA1=0.9, double BETA2=0.9, double EPSILON=1E-5);
 void WeightTransfer_2T1F(void);
 void WeightTransfer(void);
 void TransferEnergyLatencyCalculation(Array* array, SubArray* subArray);
 
-void Train(const int numTrain, const int epochs, char *optimization_type) {
-
-/* gerate random number */
-std::random_device rd;
-std::mt19937_64 gen(rd());
-
-int numBatchReadSynapse;	    // # of read synapses in a batch read operation (decide later)
-int numBatchWriteSynapse;	// # of write synapses in a batch write operation (decide later)
-double outN1[param->nHide]; // Net input to the hidden layer [param->nHide]
-double a1[param->nHide];    // Net output of hidden layer [param->nHide] also the input of hidden layer to output layer
-                                // the value after the activation function
-                                // also the input of hidden layer to output layer
-int da1[param->nHide];  // Digitized net output of hidden layer [param->nHide] also the input of hidden layer to output layer
-double outN2[param->nOutput];   // Net input to the output layer [param->nOutput]
-double a2[param->nOutput];  // Net output of output layer [param->nOutput]
-
-double s1[param->nHide];    // Output delta from input layer to the hidden layer [param->nHide]
-double s2[param->nOutput];  // Output delta from hidden layer to the output layer [param->nOutput]
-
-int train_batchsize = param -> numTrainImagesPerBatch;
+/* Read energy and latency of the hardware FF of one training sample. The samples of a mini-batch that run concurrently keep
+   their own, and they are added to the arrays and NeuroSim cores in sample order, so that the totals do not depend on the thread schedule */
+class ReadCost {
+public:
+	double arrayEnergyIH;		// Added to arrayIH->readEnergy
+	double neuroSimEnergyIH;	// Added to subArrayIH->readDynamicEnergy
+	double latencyIH;			// Added to subArrayIH->readLatency
+	double arrayEnergyHO;
+	double neuroSimEnergyHO;
+	double latencyHO;
+
+	ReadCost() { Clear(); }
+	void Clear() {
+		arrayEnergyIH = neuroSimEnergyIH = latencyIH = 0;
+		arrayEnergyHO = neuroSimEnergyHO = latencyHO = 0;
+	}
+	void Commit() {
+		arrayIH->readEnergy += arrayEnergyIH;
+		subArrayIH->readDynamicEnergy += neuroSimEnergyIH;
+		subArrayIH->readLatency += latencyIH;
+		arrayHO->readEnergy += arrayEnergyHO;
+		subArrayHO->readDynamicEnergy += neuroSimEnergyHO;
+		subArrayHO->readLatency += latencyHO;
+		Clear();
+	}
+};
+
+/* Forward pass and backpropagation of training image i into the given per-sample vectors, which lets the samples of a mini-batch run on different threads.
+   The read energy and latency of the hardware FF are added to cost. The loops run over the layer sizes of shape, constants in a build with a fixed NetworkShape.
+   Every thread of the team of the sample calls it: the layer loops are orphaned work-sharing loops, so that the sample forks its team once.
+   The vectors and cost are shared by the team, and a thread that runs a sample alone calls it in a team of its own (num_threads(1)) */
+static void ForwardBackward(const TrainNetworkShape &shape, int i, double *outN1, double *a1, int *da1, ActiveRowList &da1Rows, double *outN2, double *a2, double *s1, double *s2, ReadCost &cost) {
+	int numBatchReadSynapse;	    // # of read synapses in a batch read operation (decide later)
+
+	#pragma omp single
+	{
+		std::fill_n(outN1, shape.nHide, 0);
+		std::fill_n(a1, shape.nHide, 0);
+		std::fill_n(outN2, shape.nOutput, 0);
+		std::fill_n(a2, shape.nOutput, 0);
+		std::fill_n(s1, shape.nHide, 0);
+	}
+
+	/* First layer (input layer to the hidden layer) */
+	if (param->useHardwareInTrainingFF) {   // Hardware
+		double sumArrayReadEnergy = 0;   // Read energy of the columns of this thread, added to cost after the loop
+		double readVoltage;
+		double readVoltageMSB;  // for the hybrid cell
+		double readPulseWidth;
+		double readPulseWidthMSB;   // for the hybrid cell
+		if(arrayIH->IsAnalogNVM())
+		{
+			readVoltage = static_cast<eNVM*>(arrayIH->cell[0][0])->readVoltage;
+			readPulseWidth = static_cast<eNVM*>(arrayIH->cell[0][0])->readPulseWidth;
+		}
 
-	
-	for (int t = 0; t < epochs; t++) {
-		for (int batchSize = 0; batchSize < numTrain; batchSize++) {
-			int i = rand() % param->numMnistTrainImages;  // Randomize sample
-			/* First layer (input layer to the hidden layer) */
-			std::fill_n(outN1, param->nHide, 0);
-			std::fill_n(a1, param->nHide, 0);
-        if (param->useHardwareInTrainingFF) {   // Hardware
-				double sumArrayReadEnergy = 0;   // Use a temporary variable here since OpenMP does not support reduction on class member
-                double readVoltage;
-                double readVoltageMSB;  // for the hybrid cell
-                double readPulseWidth;
-                double readPulseWidthMSB;   // for the hybrid cell
-           if(AnalogNVM *temp = dynamic_cast<AnalogNVM*>(arrayIH->cell[0][0]))
-           {
-                 readVoltage = static_cast<eNVM*>(arrayIH->cell[0][0])->readVoltage;
-				 readPulseWidth = static_cast<eNVM*>(arrayIH->cell[0][0])->readPulseWidth;
-           }
-
-            #pragma omp parallel for reduction(+: sumArrayReadEnergy)
-				for (int j=0; j<param->nHide; j++) {
-					if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(arrayIH->cell[0][0])) {  // Analog eNVM
-                        if (static_cast<eNVM*>(arrayIH->cell[0][0])->cmosAccess) {  // 1T1R
-							sumArrayReadEnergy += arrayIH->wireGateCapRow * techIH.vdd * techIH.vdd * param->nInput; // All WLs open
-						}
-					}  
-
-					for (int n=0; n<param->numBitInput; n++) {
-						double pSumMaxAlgorithm = pow(2, n) / (param->numInputLevel - 1) * arrayIH->arrayRowSize;  // Max algorithm partial weighted sum for the nth vector bit (if both max input value and max weight are 1)
-						if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(arrayIH->cell[0][0])) {  // Analog eNVM
-							double Isum = 0;    // weighted sum current
-							double IsumMax = 0; // Max weighted sum current
-                            double IsumMin = 0; 
-							double inputSum = 0;    // Weighted sum current of input vector * weight=1 column
-							for (int k=0; k<param->nInput; k++) {
-								if ((dInput[i][k]>>n) & 1) {    // if the nth bit of dInput[i][k] is 1
-									Isum += arrayIH->ReadCell(j,k);
-                                    inputSum += arrayIH->GetMediumCellReadCurrent(j,k);    // get current of Dummy Column as reference
-									sumArrayReadEnergy += arrayIH->wireCapRow * readVoltage * readVoltage; // Selected BLs (1T1R) or Selected WLs (cross-point)
-								}
-								IsumMax += arrayIH->GetMaxCellReadCurrent(j,k);
-                                IsumMin += arrayIH->GetMinCellReadCurrent(j,k);
-							}
-							sumArrayReadEnergy += Isum * readVoltage * readPulseWidth;
-							int outputDigits = (CurrentToDigits(Isum, IsumMax-IsumMin)-CurrentToDigits(inputSum, IsumMax-IsumMin));
-                            //int outputDigits = (CurrentToDigits(Isum, IsumMax)-CurrentToDigits(inputSum, IsumMax)); 
-                            outN1[j] += DigitsToAlgorithm(outputDigits, pSumMaxAlgorithm);
-						}
-                         
-					}
-					a1[j] = sigmoid(outN1[j]);
-					da1[j] = round_th(a1[j]*(param->numInputLevel-1), param->Hthreshold);
+		if (arrayIH->IsAnalogNVM() && arrayIH->cachedReadCurrent) {	// Analog eNVM, all columns read at once
+			#pragma omp single
+			{
+				if (static_cast<eNVM*>(arrayIH->cell[0][0])->cmosAccess) {  // 1T1R
+					sumArrayReadEnergy += arrayIH->wireGateCapRow * techIH.vdd * techIH.vdd * shape.nInput * shape.nHide; // All WLs open
 				}
-				arrayIH->readEnergy += sumArrayReadEnergy;
-
-				numBatchReadSynapse = (int)ceil((double)param->nHide/param->numColMuxed);
-				// Don't parallelize this loop since there may be update of member variables inside NeuroSim functions
-				for (int j=0; j<param->nHide; j+=numBatchReadSynapse) {
-					int numActiveRows = 0;  // Number of selected rows for NeuroSim
-					for (int n=0; n<param->numBitInput; n++) {
-						for (int k=0; k<param->nInput; k++) {
-							if ((dInput[i][k]>>n) & 1) {    // if the nth bit of dInput[i][k] is 1
-								numActiveRows++;
-							}
+				const unsigned short *activeRows[param->numBitInput];
+				int numActiveRows[param->numBitInput];
+				for (int n=0; n<param->numBitInput; n++) {
+					activeRows[n] = trainSet->GetActiveRows(i, n);
+					numActiveRows[n] = trainSet->GetNumActiveRows(i, n);
+				}
+				AnalogLayerForward(arrayIH, shape.nHide, activeRows, numActiveRows, outN1, a1, da1, sumArrayReadEnergy);
+				cost.arrayEnergyIH += sumArrayReadEnergy;
+			}
+		} else {
+		#pragma omp for
+			for (int j=0; j<shape.nHide; j++) {
+				if (arrayIH->IsAnalogNVM()) {  // Analog eNVM
+                    if (static_cast<eNVM*>(arrayIH->cell[0][0])->cmosAccess) {  // 1T1R
+						sumArrayReadEnergy += arrayIH->wireGateCapRow * techIH.vdd * techIH.vdd * shape.nInput; // All WLs open
+					}
+				}  
+
+				for (int n=0; n<param->numBitInput; n++) {
+					randomPhase.step = n;	// Read noise of this bit plane
+					double pSumMaxAlgorithm = pow(2, n) / (param->numInputLevel - 1) * arrayIH->arrayRowSize;  // Max algorithm partial weighted sum for the nth vector bit (if both max input value and max weight are 1)
+					if (arrayIH->IsAnalogNVM()) {  // Analog eNVM
+						double Isum = 0;    // weighted sum current
+						double IsumMax = arrayIH->columnMaxReadCurrent[j]; // Max weighted sum current (cached per column)
+						double IsumMin = arrayIH->columnMinReadCurrent[j];
+						double inputSum = 0;    // Weighted sum current of input vector * weight=1 column
+						const unsigned short *activeRows = trainSet->GetActiveRows(i, n);    // rows whose nth input bit is 1
+						int numActiveRows = trainSet->GetNumActiveRows(i, n);
+						for (int a=0; a<numActiveRows; a++) {
+							int k = activeRows[a];
+							Isum += arrayIH->ReadCell(j,k);
+							inputSum += arrayIH->mediumReadCurrent[arrayIH->CellIndex(j, k)];    // get current of Dummy Column as reference
+							sumArrayReadEnergy += arrayIH->wireCapRow * readVoltage * readVoltage; // Selected BLs (1T1R) or Selected WLs (cross-point)
 						}
+						sumArrayReadEnergy += Isum * readVoltage * readPulseWidth;
+						int outputDigits = (CurrentToDigits(Isum, IsumMax-IsumMin)-CurrentToDigits(inputSum, IsumMax-IsumMin));
+                        //int outputDigits = (CurrentToDigits(Isum, IsumMax)-CurrentToDigits(inputSum, IsumMax)); 
+                        outN1[j] += DigitsToAlgorithm(outputDigits, pSumMaxAlgorithm);
 					}
-					subArrayIH->activityRowRead = (double)numActiveRows/param->nInput/param->numBitInput;
-					subArrayIH->readDynamicEnergy += NeuroSimSubArrayReadEnergy(subArrayIH);
-					subArrayIH->readDynamicEnergy += NeuroSimNeuronReadEnergy(subArrayIH, adderIH, muxIH, muxDecoderIH, dffIH, subtractorIH);
-					subArrayIH->readLatency += NeuroSimSubArrayReadLatency(subArrayIH);
-					subArrayIH->readLatency += NeuroSimNeuronReadLatency(subArrayIH, adderIH, muxIH, muxDecoderIH, dffIH, subtractorIH);
+                 
 				}
+				a1[j] = sigmoid(outN1[j]);
+				da1[j] = round_th(a1[j]*(param->numInputLevel-1), param->Hthreshold);
+			}
+			#pragma omp atomic
+			cost.arrayEnergyIH += sumArrayReadEnergy;
+		}
+		#pragma omp single nowait	// The barrier of the NeuroSim loop below completes it
+		da1Rows.Build(da1);
+
+		numBatchReadSynapse = (int)ceil((double)shape.nHide/param->numColMuxed);
+		// Don't parallelize this loop since there may be update of member variables inside NeuroSim functions
+		#pragma omp single
+		#pragma omp critical    // Use critical here since the samples of a mini-batch may run on different threads (NeuroSim functions update the members of subArrayIH)
+		for (int j=0; j<shape.nHide; j+=numBatchReadSynapse) {
+			int numActiveRows = trainSet->GetNumActiveRows(i);  // Number of selected rows for NeuroSim
+			subArrayIH->activityRowRead = (double)numActiveRows/shape.nInput/param->numBitInput;
+			cost.neuroSimEnergyIH += NeuroSimSubArrayReadEnergy(subArrayIH);
+			cost.neuroSimEnergyIH += NeuroSimNeuronReadEnergy(subArrayIH, adderIH, muxIH, muxDecoderIH, dffIH, subtractorIH);
+			cost.latencyIH += NeuroSimSubArrayReadLatency(subArrayIH);
+			cost.latencyIH += NeuroSimNeuronReadLatency(subArrayIH, adderIH, muxIH, muxDecoderIH, dffIH, subtractorIH);
+		}
 
 
-        } 
-        else {    // Algorithm
-				#pragma omp parallel for
-				for (int j = 0; j < param->nHide; j++) {
-					for (int k = 0; k < param->nInput; k++) {
-						outN1[j] += Input[i][k] * weight1[j][k];
-					}
-					a1[j] = sigmoid(outN1[j]);
-				}
-        }
+	}
+	else {    // Algorithm
+		#pragma omp for
+		for (int j = 0; j < shape.nHide; j++) {
+			for (int k = 0; k < shape.nInput; k++) {
+				outN1[j] += trainSet->GetInput(i, k) * weight1[j][k];
+			}
+			a1[j] = sigmoid(outN1[j]);
+		}
+	}
+
+	/* Second layer (hidder layer to the output layer) */
+	if (param->useHardwareInTrainingFF) {   // Hardware
+		double sumArrayReadEnergy = 0;  // Read energy of the columns of this thread, added to cost after the loop
+		double readVoltage;
+		double readPulseWidth;
+		double readVoltageMSB;
+		double readPulseWidthMSB;
+		if(arrayHO->IsAnalogNVM()){
+			readVoltage = static_cast<eNVM*>(arrayHO->cell[0][0])->readVoltage;
+			readPulseWidth = static_cast<eNVM*>(arrayHO->cell[0][0])->readPulseWidth;
+		}
 
-			/* Second layer (hidder layer to the output layer) */
-			std::fill_n(outN2, param->nOutput, 0);
-			std::fill_n(a2, param->nOutput, 0);
-			if (param->useHardwareInTrainingFF) {   // Hardware
-            double sumArrayReadEnergy = 0;  // Use a temporary variable here since OpenMP does not support reduction on class member
-            double readVoltage;
-            double readPulseWidth;
-            double readVoltageMSB;
-            double readPulseWidthMSB;
-            if(AnalogNVM *temp = dynamic_cast<AnalogNVM*>(arrayHO->cell[0][0])){
-                readVoltage = static_cast<eNVM*>(arrayHO->cell[0][0])->readVoltage;
-				readPulseWidth = static_cast<eNVM*>(arrayHO->cell[0][0])->readPulseWidth;
-            }		
-
-                #pragma omp parallel for reduction(+: sumArrayReadEnergy)
-				for (int j=0; j<param->nOutput; j++) {
-					if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(arrayHO->cell[0][0])) {  // Analog eNVM
-						if (static_cast<eNVM*>(arrayHO->cell[0][0])->cmosAccess) {  // 1T1R
-							sumArrayReadEnergy += arrayHO->wireGateCapRow * techHO.vdd * techHO.vdd * param->nHide; // All WLs open
-						}
-					} 
-                    
-					for (int n=0; n<param->numBitInput; n++) {
-						double pSumMaxAlgorithm = pow(2, n) / (param->numInputLevel - 1) * arrayHO->arrayRowSize;    // Max algorithm partial weighted sum for the nth vector bit (if both max input value and max weight are 1)
-						if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(arrayHO->cell[0][0])) {  // Analog eNVM
-							double Isum = 0;    // weighted sum current
-							double IsumMax = 0; // Max weighted sum current
-                            double IsumMin = 0; 
-							double a1Sum = 0;    // Weighted sum current of input vector * weight=1 column                            
-							for (int k=0; k<param->nHide; k++) {
-								if ((da1[k]>>n) & 1) {    // numbit is 8 
-							 		Isum += arrayHO->ReadCell(j,k);
-                                    a1Sum +=arrayHO->GetMediumCellReadCurrent(j,k);
-                                    sumArrayReadEnergy += arrayHO->wireCapRow * readVoltage * readVoltage; // Selected BLs (1T1R) or Selected WLs (cross-point)								                                  
-                                }
-                                IsumMax += arrayHO->GetMaxCellReadCurrent(j,k);
-                                IsumMin += arrayHO->GetMinCellReadCurrent(j,k);
-							}
-							sumArrayReadEnergy += Isum * readVoltage * readPulseWidth;
-							int outputDigits = (CurrentToDigits(Isum, IsumMax-IsumMin)-CurrentToDigits(a1Sum, IsumMax-IsumMin)); //minus the reference
-                            outN2[j] += DigitsToAlgorithm(outputDigits, pSumMaxAlgorithm);     
-						} 
-                        
-					}
-					a2[j] = sigmoid(outN2[j]);
+		if (arrayHO->IsAnalogNVM() && arrayHO->cachedReadCurrent) {	// Analog eNVM, all columns read at once
+			#pragma omp single
+			{
+				if (static_cast<eNVM*>(arrayHO->cell[0][0])->cmosAccess) {  // 1T1R
+					sumArrayReadEnergy += arrayHO->wireGateCapRow * techHO.vdd * techHO.vdd * shape.nHide * shape.nOutput; // All WLs open
 				}
-				arrayHO->readEnergy += sumArrayReadEnergy;
-				numBatchReadSynapse = (int)ceil((double)param->nOutput/param->numColMuxed);
-				// Don't parallelize this loop since there may be update of member variables inside NeuroSim functions
-				for (int j=0; j<param->nOutput; j+=numBatchReadSynapse) {
-					int numActiveRows = 0;  // Number of selected rows for NeuroSim
-					for (int n=0; n<param->numBitInput; n++) {
-						for (int k=0; k<param->nHide; k++) {
-							if ((da1[k]>>n) & 1) {    // if the nth bit of da1[k] is 1
-								numActiveRows++;
-							}
-						}
+				const unsigned short *activeRows[param->numBitInput];
+				int numActiveRows[param->numBitInput];
+				for (int n=0; n<param->numBitInput; n++) {
+					activeRows[n] = da1Rows.GetActiveRows(n);
+					numActiveRows[n] = da1Rows.GetNumActiveRows(n);
+				}
+				AnalogLayerForward(arrayHO, shape.nOutput, activeRows, numActiveRows, outN2, a2, NULL, sumArrayReadEnergy);
+				cost.arrayEnergyHO += sumArrayReadEnergy;
+			}
+		} else {
+		#pragma omp for
+			for (int j=0; j<shape.nOutput; j++) {
+				if (arrayHO->IsAnalogNVM()) {  // Analog eNVM
+					if (static_cast<eNVM*>(arrayHO->cell[0][0])->cmosAccess) {  // 1T1R
+						sumArrayReadEnergy += arrayHO->wireGateCapRow * techHO.vdd * techHO.vdd * shape.nHide; // All WLs open
 					}
-					subArrayHO->activityRowRead = (double)numActiveRows/param->nHide/param->numBitInput;
-					subArrayHO->readDynamicEnergy += NeuroSimSubArrayReadEnergy(subArrayHO);
-					subArrayHO->readDynamicEnergy += NeuroSimNeuronReadEnergy(subArrayHO, adderHO, muxHO, muxDecoderHO, dffHO, subtractorHO);
-					subArrayHO->readLatency += NeuroSimSubArrayReadLatency(subArrayHO);
-					subArrayHO->readLatency += NeuroSimNeuronReadLatency(subArrayHO, adderHO, muxHO, muxDecoderHO, dffHO, subtractorHO);
+				} 
+            
+				for (int n=0; n<param->numBitInput; n++) {
+					randomPhase.step = n;	// Read noise of this bit plane
+					double pSumMaxAlgorithm = pow(2, n) / (param->numInputLevel - 1) * arrayHO->arrayRowSize;    // Max algorithm partial weighted sum for the nth vector bit (if both max input value and max weight are 1)
+					if (arrayHO->IsAnalogNVM()) {  // Analog eNVM
+						double Isum = 0;    // weighted sum current
+						double IsumMax = arrayHO->columnMaxReadCurrent[j]; // Max weighted sum current (cached per column)
+						double IsumMin = arrayHO->columnMinReadCurrent[j];
+						double a1Sum = 0;    // Weighted sum current of input vector * weight=1 column                            
+						const unsigned short *activeRows = da1Rows.GetActiveRows(n);    // rows whose nth bit of da1 is 1
+						int numActiveRows = da1Rows.GetNumActiveRows(n);
+						for (int a=0; a<numActiveRows; a++) {
+							int k = activeRows[a];
+							Isum += arrayHO->ReadCell(j,k);
+							a1Sum += arrayHO->mediumReadCurrent[arrayHO->CellIndex(j, k)];
+							sumArrayReadEnergy += arrayHO->wireCapRow * readVoltage * readVoltage; // Selected BLs (1T1R) or Selected WLs (cross-point)
+						}
+						sumArrayReadEnergy += Isum * readVoltage * readPulseWidth;
+						int outputDigits = (CurrentToDigits(Isum, IsumMax-IsumMin)-CurrentToDigits(a1Sum, IsumMax-IsumMin)); //minus the reference
+                        outN2[j] += DigitsToAlgorithm(outputDigits, pSumMaxAlgorithm);     
+					} 
+                
 				}
+				a2[j] = sigmoid(outN2[j]);
+			}
+			#pragma omp atomic
+			cost.arrayEnergyHO += sumArrayReadEnergy;
+		}
+		numBatchReadSynapse = (int)ceil((double)shape.nOutput/param->numColMuxed);
+		// Don't parallelize this loop since there may be update of member variables inside NeuroSim functions
+		#pragma omp single nowait	// Nothing below reads the HO cost
+		#pragma omp critical    // Use critical here since the samples of a mini-batch may run on different threads (NeuroSim functions update the members of subArrayHO)
+		for (int j=0; j<shape.nOutput; j+=numBatchReadSynapse) {
+			int numActiveRows = da1Rows.GetNumActiveRows();  // Number of selected rows for NeuroSim
+			subArrayHO->activityRowRead = (double)numActiveRows/shape.nHide/param->numBitInput;
+			cost.neuroSimEnergyHO += NeuroSimSubArrayReadEnergy(subArrayHO);
+			cost.neuroSimEnergyHO += NeuroSimNeuronReadEnergy(subArrayHO, adderHO, muxHO, muxDecoderHO, dffHO, subtractorHO);
+			cost.latencyHO += NeuroSimSubArrayReadLatency(subArrayHO);
+			cost.latencyHO += NeuroSimNeuronReadLatency(subArrayHO, adderHO, muxHO, muxDecoderHO, dffHO, subtractorHO);
+		}
+
+	} else {
+		#pragma omp for
+		for (int j = 0; j < shape.nOutput; j++) {
+			for (int k = 0; k < shape.nHide; k++) {
+				outN2[j] += a1[k] * weight2[j][k];
+			}
+			a2[j] = sigmoid(outN2[j]);
+		}
+	}
+
+	// Backpropagation
+	/* Second layer (hidden layer to the output layer) */
+	#pragma omp single
+	for (int j = 0; j < shape.nOutput; j++){
+		s2[j] = -2*a2[j] * (1 - a2[j])*(trainSet->GetOutput(i, j) - a2[j]);
+	}
+
+	/* First layer (input layer to the hidden layer) */
+	#pragma omp for
+	for (int j = 0; j < shape.nHide; j++) {
+		for (int k = 0; k < shape.nOutput; k++) {
+			s1[j] += a1[j] * (1 - a1[j]) * weight2[k][j] * s2[k];
+		}
+	}
+}
+
+/* Work vectors of one thread in the data-parallel mini-batch */
+class BatchThreadBuffers {
+public:
+	std::vector<double> outN1, outN2, a2;
+	std::vector<int> da1;
+	ActiveRowList da1Rows;
+
+	BatchThreadBuffers(): outN1(param->nHide), outN2(param->nOutput), a2(param->nOutput), da1(param->nHide), da1Rows(param->nHide, param->numBitInput) {}
+};
+
+/* Backpropagated deltas of one sample of the data-parallel mini-batch, from which the optimizers sum the gradients */
+class BatchSampleDeltas {
+public:
+	int i;	// Training image
+	std::vector<double> a1, s1, s2;
+
+	BatchSampleDeltas(): i(0), a1(param->nHide), s1(param->nHide), s2(param->nOutput) {}
+};
+
+/* Forward pass and backpropagation of the training samples [firstSample, firstSample+numSamples) on all threads, whose gradients are
+   added to the optimizers. The weights do not change within a mini-batch, so this gives the same gradients as running the samples in turn.
+   Each sample keys its random streams (read noise) by its sample and keeps its own deltas (deltas[0..numSamples)) and read costs
+   (cost[0..numSamples)), and the gradients and costs are added in sample order, so the results do not depend on the # of threads */
+static void ForwardBackwardBatch(const TrainNetworkShape &shape, const int *sampleIndex, int firstSample, int numSamples, std::vector<BatchThreadBuffers> &buffers,
+		std::vector<BatchSampleDeltas> &deltas, std::vector<ReadCost> &cost) {
+	#pragma omp parallel num_threads(buffers.size()) copyin(randomPhase)
+	{
+		BatchThreadBuffers &b = buffers[omp_get_thread_num()];
+		#pragma omp for schedule(static, 1)
+		for (int n = 0; n < numSamples; n++) {
+			BatchSampleDeltas &d = deltas[n];
+			d.i = sampleIndex[n];
+			randomPhase.stage = RANDOM_TRAIN;	// Key of the random streams of this sample
+			randomPhase.sample = firstSample + n;
+			randomPhase.step = 0;
+			#pragma omp parallel num_threads(1)	// Each thread runs its samples alone
+			ForwardBackward(shape, d.i, b.outN1.data(), d.a1.data(), b.da1.data(), b.da1Rows, b.outN2.data(), b.a2.data(), d.s1.data(), d.s2.data(), cost[n]);
+		}
+
+		/* Each thread sums whole rows of the gradients, over the samples in sample order */
+		#pragma omp for nowait
+		for (int k = 0; k < shape.nInput; k++) {
+			for (int n = 0; n < numSamples; n++) {
+				double input = trainSet->GetInput(deltas[n].i, k);
+				if (input == 0) { continue; }
+				optimizerIH->AddRowGradient(k, deltas[n].s1.data(), input);
+			}
+		}
+		#pragma omp for
+		for (int k = 0; k < shape.nHide; k++) {
+			for (int n = 0; n < numSamples; n++) {
+				optimizerHO->AddRowGradient(k, deltas[n].s2.data(), deltas[n].a1[k]);
+			}
+		}
+	}
+	for (int n = 0; n < numSamples; n++) {
+		cost[n].Commit();
+	}
+}
+
+/* Draw the next sample of this replica: the replicas draw the same random sample stream and take its samples in turn */
+static int DrawSample() {
+	int sample = 0;
+	for (int r = 0; r < replicas->numReplicas; r++) {
+		int n = rand() % param->numMnistTrainImages;
+		if (r == replicas->replica) {
+			sample = n;
+		}
+	}
+	return sample;
+}
 
-			} else {
-				#pragma omp parallel for
-				for (int j = 0; j < param->nOutput; j++) {
-					for (int k = 0; k < param->nHide; k++) {
-						outN2[j] += a1[k] * weight2[j][k];
+/* Asynchronous (Hogwild) software training of numTrain samples: the threads take the samples in turn and update weight1 and weight2 without locks
+   with plain SGD after every sample (main() rejects the other optimizers and mini-batches), and leave the last change of each weight in deltaWeight1/2.
+   A thread may read weights that another thread is updating, which perturbs SGD only slightly since the updates are small and sparse */
+static void TrainHogwild(const TrainNetworkShape &shape, int numTrain) {
+	std::vector<int> sampleIndex(numTrain);
+	for (int n = 0; n < numTrain; n++) {
+		sampleIndex[n] = rand() % param->numMnistTrainImages;  // Randomize sample (drawn in turn since rand() is not thread-safe)
+	}
+	#pragma omp parallel copyin(randomPhase)
+	{
+		std::vector<double> outN1(shape.nHide), a1(shape.nHide), outN2(shape.nOutput), a2(shape.nOutput), s1(shape.nHide), s2(shape.nOutput);
+		std::vector<int> da1(shape.nHide);
+		ActiveRowList da1Rows(shape.nHide, param->numBitInput);
+		ReadCost cost;	// Software FF, no read cost
+		#pragma omp for schedule(dynamic, 16)
+		for (int n = 0; n < numTrain; n++) {
+			int i = sampleIndex[n];
+			randomPhase.stage = RANDOM_TRAIN;	// Key of the random streams of this sample
+			randomPhase.sample = n;
+			randomPhase.step = 0;
+			#pragma omp parallel num_threads(1)	// Each thread runs its samples alone
+			ForwardBackward(shape, i, outN1.data(), a1.data(), da1.data(), da1Rows, outN2.data(), a2.data(), s1.data(), s2.data(), cost);
+			for (int j = 0; j < shape.nHide; j++) {
+				for (int k = 0; k < shape.nInput; k++) {
+					double input = trainSet->GetInput(i, k);
+					if (input == 0) {
+						deltaWeight1[j][k] = 0;
+						continue;
 					}
-					a2[j] = sigmoid(outN2[j]);
+					double weightPrev = weight1[j][k];
+					double weight = std::max(param->minWeight, std::min(param->maxWeight, weightPrev - param->alpha1 * s1[j] * input));
+					deltaWeight1[j][k] = weight - weightPrev;	// Weight change after the clipping, as in the synchronous software WU
+					weight1[j][k] = weight;
 				}
 			}
-
-			// Backpropagation
-			/* Second layer (hidden layer to the output layer) */
-			for (int j = 0; j < param->nOutput; j++){
-                s2[j] = -2*a2[j] * (1 - a2[j])*(Output[i][j] - a2[j]);
+			for (int j = 0; j < shape.nOutput; j++) {
+				for (int k = 0; k < shape.nHide; k++) {
+					double weightPrev = weight2[j][k];
+					double weight = std::max(param->minWeight, std::min(param->maxWeight, weightPrev - param->alpha2 * s2[j] * a1[k]));
+					deltaWeight2[j][k] = weight - weightPrev;
+					weight2[j][k] = weight;
+				}
 			}
+		}
+	}
+}
 
-			/* First layer (input layer to the hidden layer) */
-			std::fill_n(s1, param->nHide, 0);
-			#pragma omp parallel for
-			for (int j = 0; j < param->nHide; j++) {
-				for (int k = 0; k < param->nOutput; k++) {
-					s1[j] += a1[j] * (1 - a1[j]) * weight2[k][j] * s2[k];
+/* Write configuration of a layer, fixed for the whole WU (all the cells of an array share the write scheme of cell[0][0]) */
+class LayerWrite {
+public:
+	Array *array;
+	double vdd;				// Supply voltage of the layer's technology
+	int numRows;			// # of synapse rows of the layer
+	int numCols;			// # of synapse columns of the layer
+	int numBatchWriteSynapse;
+	bool nonIdenticalPulse;	// Non-identical write pulse scheme
+	bool is2T1F;
+	double writeVoltageLTP;	// Write voltage on the array caps (the average voltage of the non-identical pulse scheme)
+	double writeVoltageLTD;
+
+	LayerWrite(Array *array, double vdd, int numRows, int numCols, int numBatchWriteSynapse): array(array), vdd(vdd), numRows(numRows),
+		numCols(numCols), numBatchWriteSynapse(numBatchWriteSynapse), nonIdenticalPulse(false), is2T1F(array->Is2T1F()), writeVoltageLTP(0), writeVoltageLTD(0) {
+		if (array->IsAnalogNVM()) {
+			AnalogNVM *first = static_cast<AnalogNVM*>(array->cell[0][0]);
+			nonIdenticalPulse = first->nonIdenticalPulse;
+			writeVoltageLTP = nonIdenticalPulse? first->VinitLTP + 0.5 * first->VstepLTP * first->maxNumLevelLTP : first->writeVoltageLTP;
+			writeVoltageLTD = nonIdenticalPulse? first->VinitLTD + 0.5 * first->VstepLTD * first->maxNumLevelLTD : first->writeVoltageLTD;
+		}
+	}
+};
+
+typedef void (*BatchWriteEnergyKernel)(const LayerWrite &layer, int k, int start, int end, double maxLatencyLTP, double maxLatencyLTD, bool weightChangeBatch, bool writeBatch, WriteLedger &row);
+
+/* Write energy of the batch write of the cells start..end of row k of an analog eNVM array (cells, array caps and half-selected cells),
+   instantiated per write scheme so that the WU loop neither tests the flags nor casts the cells for each cell */
+template <bool nonIdenticalPulse, bool cmosAccess>
+static void BatchWriteEnergy(const LayerWrite &layer, int k, int start, int end, double maxLatencyLTP, double maxLatencyLTD, bool weightChangeBatch, bool writeBatch, WriteLedger &row) {
+	Array *array = layer.array;
+	double writeVoltageLTP = layer.writeVoltageLTP;
+	double writeVoltageLTD = layer.writeVoltageLTD;
+	if (weightChangeBatch) {
+		for (int jj = start; jj <= end; jj++) {	// Selected cells
+			AnalogNVM *cell = static_cast<AnalogNVM*>(array->cell[jj][k]);
+			if (nonIdenticalPulse) {
+				int numPulse = array->numPulse[array->CellIndex(jj, k)];
+				if (numPulse > 0) {	// LTP
+					cell->writeVoltageLTP = sqrt(cell->writeVoltageSquareSum / numPulse);	// RMS value of LTP write voltage
+					cell->writeVoltageLTD = cell->VinitLTD + 0.5 * cell->VstepLTD * cell->maxNumLevelLTD;	// Use average voltage of LTD write voltage
+				} else if (numPulse < 0) {	// LTD
+					cell->writeVoltageLTP = cell->VinitLTP + 0.5 * cell->VstepLTP * cell->maxNumLevelLTP;    // Use average voltage of LTP write voltage
+					cell->writeVoltageLTD = sqrt(cell->writeVoltageSquareSum / (-1*numPulse));    // RMS value of LTD write voltage
+				} else {	// Half-selected during LTP and LTD phases
+					cell->writeVoltageLTP = cell->VinitLTP + 0.5 * cell->VstepLTP * cell->maxNumLevelLTP;    // Use average voltage of LTP write voltage
+					cell->writeVoltageLTD = cell->VinitLTD + 0.5 * cell->VstepLTD * cell->maxNumLevelLTD;    // Use average voltage of LTD write voltage
 				}
 			}
+			cell->WriteEnergyCalculation(array->wireCapCol);
+			row.arrayWriteEnergy += cell->writeEnergy;
+			// add the transfer energy if this is a 2T1F cell
+			// the transfer energy will be 0 if there is no transfer
+			if (layer.is2T1F) {
+				row.arrayWriteEnergy += static_cast<_2T1F*>(array->cell[jj][k])->transWriteEnergy;
+			}
+		}
 
-			// Weight update
-			/* Update weight of the first layer (input layer to the hidden layer) */
-			if (param->useHardwareInTrainingWU) {
-				double sumArrayWriteEnergy = 0;   // Use a temporary variable here since OpenMP does not support reduction on class member
-				double sumNeuroSimWriteEnergy = 0;   // Use a temporary variable here since OpenMP does not support reduction on class member
-				double sumWriteLatencyAnalogNVM = 0;   // Use a temporary variable here since OpenMP does not support reduction on class member
-				double numWriteOperation = 0;	// Average number of write batches in the whole array. Use a temporary variable here since OpenMP does not support reduction on class member
-                double writeVoltageLTP = static_cast<eNVM*>(arrayIH->cell[0][0])->writeVoltageLTP;
-                double writeVoltageLTD = static_cast<eNVM*>(arrayIH->cell[0][0])->writeVoltageLTD;
-                double writePulseWidthLTP = static_cast<eNVM*>(arrayIH->cell[0][0])->writePulseWidthLTP;
-                double writePulseWidthLTD = static_cast<eNVM*>(arrayIH->cell[0][0])->writePulseWidthLTD;
-                if(eNVM *temp = dynamic_cast<eNVM*>(arrayIH->cell[0][0])){
-                    writeVoltageLTP = static_cast<eNVM*>(arrayIH->cell[0][0])->writeVoltageLTP;
-                    writeVoltageLTD = static_cast<eNVM*>(arrayIH->cell[0][0])->writeVoltageLTD;
-				    writePulseWidthLTP = static_cast<eNVM*>(arrayIH->cell[0][0])->writePulseWidthLTP;
-				    writePulseWidthLTD = static_cast<eNVM*>(arrayIH->cell[0][0])->writePulseWidthLTD;
-                }
-                
-                numBatchWriteSynapse = (int)ceil((double)arrayIH->arrayColSize / param->numWriteColMuxed);
+		/* Energy consumption on array caps */
+		if (cmosAccess) {  // 1T1R
+			// The energy on selected SLs is included in WriteCell()
+			row.arrayWriteEnergy += array->wireGateCapRow * layer.vdd * layer.vdd * 2;   // Selected WL (*2 means both LTP and LTD phases)
+			row.arrayWriteEnergy += array->wireCapRow * writeVoltageLTP * writeVoltageLTP;   // Selected BL (LTP phases)
+			row.arrayWriteEnergy += array->wireCapCol * writeVoltageLTP * writeVoltageLTP * (layer.numCols-layer.numBatchWriteSynapse);   // Unselected SLs (LTP phase)
+			// No LTD part because all unselected rows and columns are V=0
+		} else {
+			row.arrayWriteEnergy += array->wireCapRow * writeVoltageLTP * writeVoltageLTP;    // Selected WL (LTP phase)
+			row.arrayWriteEnergy += array->wireCapRow * writeVoltageLTP/2 * writeVoltageLTP/2 * (layer.numRows - 1);  // Unselected WLs (LTP phase)
+			row.arrayWriteEnergy += array->wireCapCol * writeVoltageLTP/2 * writeVoltageLTP/2 * (layer.numCols - layer.numBatchWriteSynapse);   // Unselected BLs (LTP phase)
+			row.arrayWriteEnergy += array->wireCapRow * writeVoltageLTD/2 * writeVoltageLTD/2 * (layer.numRows - 1);    // Unselected WLs (LTD phase)
+			row.arrayWriteEnergy += array->wireCapCol * writeVoltageLTD/2 * writeVoltageLTD/2 * (layer.numCols - layer.numBatchWriteSynapse); // Unselected BLs (LTD phase)
+		}
+	}
+
+	/* Half-selected cells of cross-point */
+	if (!cmosAccess && writeBatch) {
+		/* Half-selected cells in the same row (all but the selected cells) and in the selected columns of the other rows */
+		// The other rows see the conductance of before this WU, whichever thread writes them and when
+		double halfSelectedLTP = array->rowHalfVwLTP[k];
+		double halfSelectedLTD = array->rowHalfVwLTD[k];
+		for (int jj = start; jj <= end; jj++) {
+			int index = array->CellIndex(jj, k);
+			halfSelectedLTP += array->columnHalfVwLTP[jj] + array->columnHalfVwDeltaLTP[index] - 2 * array->conductanceAtHalfVwLTP[index];
+			halfSelectedLTD += array->columnHalfVwLTD[jj] + array->columnHalfVwDeltaLTD[index] - 2 * array->conductanceAtHalfVwLTD[index];
+		}
+		row.arrayWriteEnergy += writeVoltageLTP/2 * writeVoltageLTP/2 * halfSelectedLTP * maxLatencyLTP + writeVoltageLTD/2 * writeVoltageLTD/2 * halfSelectedLTD * maxLatencyLTD;
+	}
+}
 
+/* Instantiation of BatchWriteEnergy() for the write scheme of the layer, picked once per WU (NULL: no write energy report, or not analog eNVM) */
+static BatchWriteEnergyKernel BatchWriteEnergyOf(const LayerWrite &layer) {
+	if (!param->writeEnergyReport || !layer.array->IsAnalogNVM()) {
+		return NULL;
+	}
+	bool cmosAccess = static_cast<eNVM*>(layer.array->cell[0][0])->cmosAccess;
+	if (layer.nonIdenticalPulse) {
+		return cmosAccess? &BatchWriteEnergy<true, true> : &BatchWriteEnergy<true, false>;
+	}
+	return cmosAccess? &BatchWriteEnergy<false, true> : &BatchWriteEnergy<false, false>;
+}
 
-				/* Stochastic pulse WU */
-				int maxNumLevelLTP = 97;
-				int maxNumLevelLTD = 100;
-				double ProbConstLTP = sqrt((param->alpha1 / (pow(2, t/10)) * maxNumLevelLTP) / (param->StreamLength * (param->maxWeight - param->minWeight)));
-				double ProbConstLTD = sqrt((param->alpha1 / (pow(2, t/10)) * maxNumLevelLTD) / (param->StreamLength * (param->maxWeight - param->minWeight)));
+void Train(const int numTrain, const int epochs) {
 
-				double C = sqrt((param->alpha1 / (pow(2, t/10))) / (param->StreamLength * 0.001));
+const TrainNetworkShape shape(param);	// Layer sizes of the FF and backpropagation kernels
 
-				int **pulse = new int *[param->nInput];
-				#pragma omp parallel for
-				for (int n = 0; n < param->nInput; n++) {
-					pulse[n] = new int[param->nHide];
-				}
+/* Scratch buffers: the vectors of a sample, followed by the pulse counts, signs, weight changes and write ledgers of the first layer's WU.
+   The second layer's WU has its own buffers, since the two WUs run concurrently */
+Workspace workspace(3 * Workspace::Bytes<double>(param->nHide) + Workspace::Bytes<int>(param->nHide) + 3 * Workspace::Bytes<double>(param->nOutput)
+	+ Workspace::MatrixBytes<int>(param->nInput, param->nHide) + Workspace::Bytes<bool>(param->nInput) + Workspace::Bytes<bool>(param->nHide) + Workspace::MatrixBytes<double>(param->nInput, param->nHide)
+	+ Workspace::Bytes<WriteLedger>(param->nInput));
+Workspace workspaceHO(Workspace::MatrixBytes<int>(param->nHide, param->nOutput) + Workspace::Bytes<bool>(param->nHide) + Workspace::Bytes<bool>(param->nOutput) + Workspace::MatrixBytes<double>(param->nHide, param->nOutput)
+	+ Workspace::Bytes<WriteLedger>(param->nHide));
 
-				#pragma omp parallel for collapse(2)
-				for (int n = 0; n < param->nInput; n++) {
-					for (int m = 0; m < param->nHide; m++) {
-						pulse[n][m] = 0;
-					}
+double *outN1 = workspace.Allocate<double>(param->nHide); // Net input to the hidden layer [param->nHide]
+double *a1 = workspace.Allocate<double>(param->nHide);    // Net output of hidden layer [param->nHide] also the input of hidden layer to output layer
+                                // the value after the activation function
+                                // also the input of hidden layer to output layer
+int *da1 = workspace.Allocate<int>(param->nHide);  // Digitized net output of hidden layer [param->nHide] also the input of hidden layer to output layer
+ActiveRowList da1Rows(param->nHide, param->numBitInput);  // Active rows of da1 for each bit plane
+PulseTrainSet inputPulseIH(param->nInput, param->StreamLength);	// Stochastic pulse trains of the inputs of arrayIH
+PulseTrainSet deltaPulseIH(param->nHide, param->StreamLength);	// Stochastic pulse trains of the deltas of arrayIH
+PulseTrainSet inputPulseHO(param->nHide, param->StreamLength);	// Stochastic pulse trains of the inputs of arrayHO
+PulseTrainSet deltaPulseHO(param->nOutput, param->StreamLength);	// Stochastic pulse trains of the deltas of arrayHO
+PulseWorklist worklistIH(param->nInput, param->nHide);	// Cells of arrayIH with a nonzero pulse count
+PulseWorklist worklistHO(param->nHide, param->nOutput);	// Cells of arrayHO with a nonzero pulse count
+/* Sparse WU: only write the batches on the worklist. It needs every weight to be the read-back of its cell, so it is enabled
+   after a dense WU, and only when a cell read is deterministic (cached read current) and every sample writes (SGD) */
+bool sparseWUIH = false;
+bool sparseWUHO = false;
+double *outN2 = workspace.Allocate<double>(param->nOutput);   // Net input to the output layer [param->nOutput]
+double *a2 = workspace.Allocate<double>(param->nOutput);  // Net output of output layer [param->nOutput]
+
+double *s1 = workspace.Allocate<double>(param->nHide);    // Output delta from input layer to the hidden layer [param->nHide]
+double *s2 = workspace.Allocate<double>(param->nOutput);  // Output delta from hidden layer to the output layer [param->nOutput]
+
+size_t sampleMark = workspace.Mark();	// The WU buffers below this mark are released after the first layer's WU
+
+/* Concurrent WU of the two layers: each layer gets a share of the threads by its # of cells. The replicas all-reduce
+   through a single ring, so they keep the layers in turn */
+int numThreads = omp_get_max_threads();
+bool concurrentWU = numThreads > 1 && !replicas->IsActive();
+int numThreadsHO = concurrentWU? std::max(1, (int)round((double)numThreads * param->nHide * param->nOutput / (param->nInput * param->nHide + param->nHide * param->nOutput))) : numThreads;
+int numThreadsIH = concurrentWU? std::max(1, numThreads - numThreadsHO) : numThreads;
+int maxActiveLevels = omp_get_max_active_levels();	// Restored after each concurrent WU, so that the other parallel loops stay unnested
+
+/* Data-parallel mini-batch: the samples of a batch but the last one run concurrently, and the last one runs the WU of the batch below.
+   The per-sample WU of the other samples would write nothing, so it is skipped */
+int train_batchsize = param->numTrainImagesPerBatch;
+/* Accumulate-then-write WU: every sample adds its pulse counts to the batch sums, and only the last sample of a batch runs the
+   WU loop, which writes the sums. The samples need their pulse counts, so they do not run data-parallel */
+bool accumulateWU = param->accumulatePulseWU && param->useHardwareInTrainingWU && !optimizerIH->UpdateEverySample() && train_batchsize > 1;
+PulseAccumulator pulseSumIH(accumulateWU? param->nInput : 0, param->nHide);
+PulseAccumulator pulseSumHO(accumulateWU? param->nHide : 0, param->nOutput);
+bool dataParallel = param->dataParallelBatch && param->useHardwareInTrainingWU && !optimizerIH->UpdateEverySample() && train_batchsize > 1 && !accumulateWU;
+std::vector<BatchThreadBuffers> batchBuffers(dataParallel? omp_get_max_threads() : 0);
+std::vector<BatchSampleDeltas> batchDeltas(dataParallel? train_batchsize : 0);	// Deltas of the concurrent samples of a batch
+std::vector<ReadCost> batchCost(dataParallel? train_batchsize : 0);	// Read costs of the concurrent samples of a batch
+ReadCost sampleCost;	// Read cost of the samples that run in turn
+std::vector<int> batchSampleIndex(train_batchsize);
+
+double startTime = omp_get_wtime();
+	for (int t = 0; t < epochs; t++) {
+		if (param->hogwildTraining && !param->useHardwareInTraining) {
+			TrainHogwild(shape, numTrain);
+			randomPhase.epoch++;
+			continue;
+		}
+		arrayIH->RebuildHalfVwSums();	// Once per epoch, so that the rounding error of the running sums does not build up
+		arrayHO->RebuildHalfVwSums();
+		for (int batchSize = 0; batchSize < numTrain; batchSize++) {
+			if (dataParallel && batchSize % train_batchsize == 0) {
+				int numConcurrent = std::min(train_batchsize - 1, numTrain - batchSize);	// A partial batch at the end has no WU and runs all concurrently
+				for (int n = 0; n < numConcurrent; n++) {
+					batchSampleIndex[n] = DrawSample();  // Randomize sample
 				}
+				ForwardBackwardBatch(shape, batchSampleIndex.data(), batchSize, numConcurrent, batchBuffers, batchDeltas, batchCost);
+				batchSize += numConcurrent;
+				if (batchSize == numTrain) {
+					break;
+				}
+			}
+			int i = DrawSample();  // Randomize sample
+			randomPhase.stage = RANDOM_TRAIN;	// Key of the random streams of this sample
+			randomPhase.sample = batchSize;
+			randomPhase.step = 0;
+			#pragma omp parallel copyin(randomPhase)	// The FF and backpropagation of the sample share one thread team
+			ForwardBackward(shape, i, outN1, a1, da1, da1Rows, outN2, a2, s1, s2, sampleCost);
+			sampleCost.Commit();
 
-				bool **InputPulseTrain = new bool *[param->nInput];
-				//bool *InputisPositive = new bool [param->nInput];
-				bool InputisPositive[param->nInput] = {};
-				
-				/* Input is Positive? or not */
-				#pragma omp parallel for
-					for (int n = 0; n < param->nInput; n++) {
-						if (Input[i][n] > 0)
-							InputisPositive[n] = 1;
-					}
-				
-				/* generate Input pulse Train */
-				#pragma omp parallel for
-					for (int n = 0; n < param->nInput; n++) {
-						InputPulseTrain[n] = new bool [2 * param->StreamLength];
-
-						double iLTP = fabs(Input[i][n] * C);
-						double iLTD = fabs(Input[i][n] * C);
-						std::bernoulli_distribution disLTP(iLTP);
-						std::bernoulli_distribution disLTD(iLTD);
-						for (int t = 0; t < param->StreamLength; t++) {
-							InputPulseTrain[n][t] = disLTP(gen);
-							InputPulseTrain[n][t + param->StreamLength] = disLTD(gen);
-						}
-					}
-				
-				bool **DeltaPulseTrain = new bool *[param->nHide];
-				//bool *DeltaisPositive = new bool [param->nHide];
-				bool DeltaisPositive[param->nHide] = {};
-
-				/* Delta is Positive? or not */
-				#pragma omp parallel for
-					for (int n = 0; n < param->nHide; n++) {
-						if (s1[n] > 0)
-							DeltaisPositive[n] = 1;
-					}
-				
-				/* generate Delta pulse train */
-				#pragma omp parallel for
-					for (int n = 0; n < param->nHide; n++) {
-						DeltaPulseTrain[n] = new bool [2 * param->StreamLength];
-
-						double dLTP = fabs(s1[n] * C);
-						double dLTD = fabs(s1[n] * C);
-						std::bernoulli_distribution disLTP(dLTP);
-						std::bernoulli_distribution disLTD(dLTD);
-						for (int t = 0; t < param->StreamLength; t++) {
-							DeltaPulseTrain[n][t] = disLTP(gen);
-							DeltaPulseTrain[n][t + param->StreamLength] = disLTD(gen);
-						}
-					}
-				
-				/* generate pulse for WU */
-				#pragma omp parallel for collapse(3)
-					for (int t = 0; t < param->StreamLength; t++) {
-						for (int n = 0; n < param->nInput; n++) {
-							for (int m = 0; m < param->nHide; m++) {
-								if (InputisPositive[n] ^ DeltaisPositive[m]) { // for LTP
-									if (InputPulseTrain[n][t] & DeltaPulseTrain[m][t])
-										pulse[n][m]++;
+			// Weight update
+			randomPhase.step = RANDOM_STEP_READBACK;	// The read-back of the written cells draws its own read noise
+			/* The WUs of the two layers only depend on s1 and s2 from here, so they run as two concurrent tasks whose parallel loops use the threads of each layer */
+			WriteLedger layerWriteIH, layerWriteHO;	// Write counters of the hardware WU of each layer
+			layerWriteIH.Clear();
+			layerWriteHO.Clear();
+			if (concurrentWU) {
+				omp_set_max_active_levels(2);
+			}
+			#pragma omp parallel num_threads(2) if(concurrentWU) copyin(randomPhase)
+			#pragma omp single
+			{
+				/* Update weight of the first layer (input layer to the hidden layer) */
+				#pragma omp task if(concurrentWU)
+				{
+					omp_set_num_threads(numThreadsIH);
+					if (param->useHardwareInTrainingWU) {
+		                int numBatchWriteSynapse = (int)ceil((double)arrayIH->arrayColSize / param->numWriteColMuxed);
+
+
+						/* Stochastic pulse WU */
+						int maxNumLevelLTP = 97;
+						int maxNumLevelLTD = 100;
+						double ProbConstLTP = sqrt((param->alpha1 / (pow(2, t/10)) * maxNumLevelLTP) / (param->StreamLength * (param->maxWeight - param->minWeight)));
+						double ProbConstLTD = sqrt((param->alpha1 / (pow(2, t/10)) * maxNumLevelLTD) / (param->StreamLength * (param->maxWeight - param->minWeight)));
+
+						double C = sqrt((param->alpha1 / (pow(2, t/10))) / (param->StreamLength * 0.001));
+
+						int **pulse = workspace.AllocateMatrix<int>(param->nInput, param->nHide);
+
+						bool *InputisPositive = workspace.Allocate<bool>(param->nInput);
+						bool *DeltaisPositive = workspace.Allocate<bool>(param->nHide);
+						double **rowDeltaWeight = workspace.AllocateMatrix<double>(param->nInput, param->nHide);	// Weight change from the optimizer, in the order of the WU loop
+						WriteLedger *ledger = workspace.Allocate<WriteLedger>(param->nInput);	// Write counters of each row, merged after the WU loop
+						bool writeSample = !accumulateWU || optimizerIH->IsUpdateSample(batchSize);	// Whether this sample runs the WU loop (only the last sample of a batch in the accumulate-then-write WU)
+						const LayerWrite layerWrite(arrayIH, techIH.vdd, param->nInput, param->nHide, numBatchWriteSynapse);
+						const BatchWriteEnergyKernel batchWriteEnergy = BatchWriteEnergyOf(layerWrite);
+						arrayIH->DeferColumnHalfVw(true);	// The column sums of the half-selected cells are merged with the ledgers
+
+						/* The phases of the WU share one thread team, and the barriers of the work-sharing loops order them */
+						#pragma omp parallel copyin(randomPhase)
+						{
+							/* Input is Positive? or not */
+							#pragma omp for nowait
+								for (int n = 0; n < param->nInput; n++) {
+									InputisPositive[n] = (trainSet->GetInput(i, n) > 0);
 								}
-								else { // for LTD
-									if (InputPulseTrain[n][t + param->StreamLength] & DeltaPulseTrain[m][t + param->StreamLength])
-										pulse[n][m]--;
+
+							/* Delta is Positive? or not */
+							#pragma omp for
+								for (int n = 0; n < param->nHide; n++) {
+									DeltaisPositive[n] = (s1[n] > 0);
 								}
-							}
-						}
-					}
-		
-				#pragma omp parallel for
-					for (int n = 0; n < param->nInput; n++) 
-						delete[] InputPulseTrain[n];
-					delete[] InputPulseTrain;
-					//delete[] InputisPositive;
-				
-				#pragma omp parallel for
-					for (int n = 0; n < param->nHide; n++)
-						delete[] DeltaPulseTrain[n];
-					delete[] DeltaPulseTrain;
-					//delete[] DeltaisPositive;
 				
-				#pragma omp parallel for reduction(+: sumArrayWriteEnergy, sumNeuroSimWriteEnergy, sumWriteLatencyAnalogNVM)
-				for (int k = 0; k < param->nInput; k++) {
-					int numWriteOperationPerRow = 0;	// Number of write batches in a row that have any weight change
-					int numWriteCellPerOperation = 0;	// Average number of write cells per batch in a row (for digital eNVM)
-					for (int j = 0; j < param->nHide; j+=numBatchWriteSynapse) {
-						/* Batch write */
-						int start = j;
-						int end = j + numBatchWriteSynapse - 1;
-						if (end >= param->nHide) {
-							end = param->nHide - 1;
-						}
-						double maxLatencyLTP = 0;	// Max latency for AnalogNVM's LTP or weight increase in this batch write
-						double maxLatencyLTD = 0;	// Max latency for AnalogNVM's LTD or weight decrease in this batch write
-						bool weightChangeBatch = false;	// Specify if there is any weight change in the entire write batch
-                        
-                        double maxWeightUpdated=0;
-                        double maxPulseNum =0;
-                        double actualWeightUpdated;
-                        for (int jj = start; jj <= end; jj++) { // Selected cells
-                            /*can support multiple optimization algorithm*/
-                            gradt = s1[jj] * Input[i][k];
-                            gradSum1[jj][k] += gradt; // sum over the gradient over all the training samples in this batch
-                            if (optimization_type == "SGD"){
-                                deltaWeight1[jj][k] = SGD(gradt, param->alpha1);                        
-                            }   
-                            else if((batchSize+1) % train_batchsize == 0){ // batch based algorithms
-                                // get the batch gradient
-                                gradSum1[jj][k] /= train_batchsize;
-                                if (optimization_type=="Momentum")
-                                {
-                                    gradSum1[jj][k] *= train_batchsize;
-                                    deltaWeight1[jj][k] = Momentum(gradSum1[jj][k], param->alpha1,momentumPrev1[jj][k]);
-                                    momentumPrev1[jj][k] = GAMA*momentumPrev1[jj][k]+(1-GAMA)*gradSum1[jj][k];
-                                }
-                                else if(optimization_type=="RMSprop")
-                                {
-                                    deltaWeight1[jj][k] = RMSprop(gradSum1[jj][k], param->alpha1, gradSquarePrev1[jj][k]);                                
-                                    gradSquarePrev1[jj][k] = GAMA*gradSquarePrev1[jj][k]+(1-GAMA)*pow(gradSum1[jj][k], 2);   
-                                }
-                                else if(optimization_type == "Adam")
-                                {
-                                    deltaWeight1[jj][k] = Adam(gradSum1[jj][k], param->alpha1, momentumPrev1[jj][k], gradSquarePrev1[jj][k],(batchSize+1)/train_batchsize);
-                                    momentumPrev1[jj][k] = BETA1*momentumPrev1[jj][k]+(1-BETA1)*gradSum1[jj][k];
-                                    gradSquarePrev1[jj][k] = BETA2*gradSquarePrev1[jj][k]+(1-BETA2)*pow(gradSum1[jj][k], 2);
-                                }
-                                else std::cout<<"please specify an optimization method" <<end;
-                                gradSum1[jj][k] = 0;
-                            }
-                    
-                           /* tracking code */
-                            totalDeltaWeight1[jj][k] += deltaWeight1[jj][k];
-                            totalDeltaWeight1_abs[jj][k] += fabs(deltaWeight1[jj][k]);
-
-                            // find the actual weight update
-                            if(deltaWeight1[jj][k]+weight1[jj][k] > param-> maxWeight)
-                            {
-                                actualWeightUpdated=param->maxWeight - weight1[jj][k];    
-                            }
-                            else if(deltaWeight1[jj][k]+weight1[jj][k] < param->minWeight)
-                            {
-                                actualWeightUpdated=param->minWeight - weight1[jj][k];
-                            } 
-                            else actualWeightUpdated=deltaWeight1[jj][k];
-                            
-                            if(fabs(actualWeightUpdated)>maxWeightUpdated)
-                            {
-                                maxWeightUpdated =fabs(actualWeightUpdated);
-                            }
-                            
-                            if(optimization_type == "SGD" || (batchSize+1) % train_batchsize == 0 ){
-                                if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(arrayIH->cell[jj][k])) {	// Analog eNVM
-                                    //arrayIH->WriteCell(jj, k, deltaWeight1[jj][k], weight1[jj][k], param->maxWeight, param->minWeight, true);
-
-									//arrayIH->WirteCellWithNum(jj, k, pulse[k][jj], weight1[jj][k], param->maxWeight, param->minWeight);
-
-									arrayIH->WriteCelltest(jj, k, pulse[k][jj], weight1[jj][k], param->maxWeight, param->minWeight);
-
-                                    weight1[jj][k] = arrayIH->ConductanceToWeight(jj, k, param->maxWeight, param->minWeight); 
-                                    weightChangeBatch = weightChangeBatch || static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->numPulse;
-                                    if(fabs(static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->numPulse) > maxPulseNum)
-                                    {
-                                        maxPulseNum=fabs(static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->numPulse);
-                                    }
-                                    /* Get maxLatencyLTP and maxLatencyLTD */
-                                    if (static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->writeLatencyLTP > maxLatencyLTP)
-                                        maxLatencyLTP = static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->writeLatencyLTP;
-                                    if (static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->writeLatencyLTD > maxLatencyLTD)
-                                        maxLatencyLTD = static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->writeLatencyLTD;
-                                }							
-                            }
-							
-						}
-                        // update the track variables
-                        totalWeightUpdate += maxWeightUpdated;
-                        totalNumPulse += maxPulseNum;
-                        
-						numWriteOperationPerRow += weightChangeBatch;
-						for (int jj = start; jj <= end; jj++) { // Selected cells
-							if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(arrayIH->cell[0][0])) {  // Analog eNVM
-								/* Set the max latency for all the selected cells in this batch */
-								static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->writeLatencyLTP = maxLatencyLTP;
-								static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->writeLatencyLTD = maxLatencyLTD;
-								if (param->writeEnergyReport && weightChangeBatch) {
-									if (static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->nonIdenticalPulse) {	// Non-identical write pulse scheme
-										if (static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->numPulse > 0) {	// LTP
-											static_cast<eNVM*>(arrayIH->cell[jj][k])->writeVoltageLTP = sqrt(static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->writeVoltageSquareSum / static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->numPulse);	// RMS value of LTP write voltage
-											static_cast<eNVM*>(arrayIH->cell[jj][k])->writeVoltageLTD = static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->VinitLTD + 0.5 * static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->VstepLTD * static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->maxNumLevelLTD;	// Use average voltage of LTD write voltage
-										} else if (static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->numPulse < 0) {	// LTD
-											static_cast<eNVM*>(arrayIH->cell[jj][k])->writeVoltageLTP = static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->VinitLTP + 0.5 * static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->VstepLTP * static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->maxNumLevelLTP;    // Use average voltage of LTP write voltage
-											static_cast<eNVM*>(arrayIH->cell[jj][k])->writeVoltageLTD = sqrt(static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->writeVoltageSquareSum / (-1*static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->numPulse));    // RMS value of LTD write voltage
-										} else {	// Half-selected during LTP and LTD phases
-											static_cast<eNVM*>(arrayIH->cell[jj][k])->writeVoltageLTP = static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->VinitLTP + 0.5 * static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->VstepLTP * static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->maxNumLevelLTP;    // Use average voltage of LTP write voltage
-											static_cast<eNVM*>(arrayIH->cell[jj][k])->writeVoltageLTD = static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->VinitLTD + 0.5 * static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->VstepLTD * static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->maxNumLevelLTD;    // Use average voltage of LTD write voltage
+							if (param->binomialPulseWU) {
+								/* draw the pulse count of each cell: the input and delta slots coincide with probability p_input*p_delta in each of the StreamLength slots */
+								#pragma omp for
+								for (int n = 0; n < param->nInput; n++) {
+									for (int m = 0; m < param->nHide; m++) {
+										double pInput = std::min(1.0, fabs(trainSet->GetInput(i, n) * C));
+										double pDelta = std::min(1.0, fabs(s1[m] * C));
+										int count = 0;
+										if (pInput > 0 && pDelta > 0) {
+											RandomStream random(RandomStreamId(RANDOM_PULSE_COUNT_IH, n * param->nHide + m), 0);	// Pulse count stream of this cell
+											std::binomial_distribution<int> dis(param->StreamLength, pInput * pDelta);
+											count = dis(random);
 										}
+										pulse[n][m] = (InputisPositive[n] ^ DeltaisPositive[m])? count : -count;	// LTP or LTD
 									}
-									static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->WriteEnergyCalculation(arrayIH->wireCapCol);
-									sumArrayWriteEnergy += static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->writeEnergy; 
-                                    // add the transfer energy if this is a 2T1F cell
-                                    // the transfer energy will be 0 if there is no transfer
-                                    if(_2T1F* temp = dynamic_cast<_2T1F*>(arrayIH->cell[jj][k]))
-                                        sumArrayWriteEnergy += static_cast<_2T1F*>(arrayIH->cell[jj][k])->transWriteEnergy;
+									worklistIH.Build(n, pulse[n]);	// Worklist of the sparse WU
 								}
-							} 
-                            
-						}
-                        
-						/* Latency for each batch write in Analog eNVM */
-						if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(arrayIH->cell[0][0])) {	// Analog eNVM
-							sumWriteLatencyAnalogNVM += maxLatencyLTP + maxLatencyLTD;
-						}
-                        
-						/* Energy consumption on array caps for eNVM */
-						if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(arrayIH->cell[0][0])) {  // Analog eNVM
-							if (param->writeEnergyReport && weightChangeBatch) {
-								if (static_cast<AnalogNVM*>(arrayIH->cell[0][0])->nonIdenticalPulse) { // Non-identical write pulse scheme
-									writeVoltageLTP = static_cast<AnalogNVM*>(arrayIH->cell[0][0])->VinitLTP + 0.5 * static_cast<AnalogNVM*>(arrayIH->cell[0][0])->VstepLTP * static_cast<AnalogNVM*>(arrayIH->cell[0][0])->maxNumLevelLTP;    // Use average voltage of LTP write voltage
-									writeVoltageLTD = static_cast<AnalogNVM*>(arrayIH->cell[0][0])->VinitLTD + 0.5 * static_cast<AnalogNVM*>(arrayIH->cell[0][0])->VstepLTD * static_cast<AnalogNVM*>(arrayIH->cell[0][0])->maxNumLevelLTD;    // Use average voltage of LTD write voltage
+							} else {
+								/* generate Input pulse Train */
+								#pragma omp for nowait
+								for (int n = 0; n < param->nInput; n++) {
+									RandomStream random(RandomStreamId(RANDOM_PULSE_INPUT_IH, n), 0);	// Pulse train stream of this input
+									inputPulseIH.Generate(n, random, fabs(trainSet->GetInput(i, n) * C));
 								}
-								if (static_cast<eNVM*>(arrayIH->cell[0][0])->cmosAccess) {  // 1T1R
-									// The energy on selected SLs is included in WriteCell()
-									sumArrayWriteEnergy += arrayIH->wireGateCapRow * techIH.vdd * techIH.vdd * 2;   // Selected WL (*2 means both LTP and LTD phases)
-									sumArrayWriteEnergy += arrayIH->wireCapRow * writeVoltageLTP * writeVoltageLTP;   // Selected BL (LTP phases)
-									sumArrayWriteEnergy += arrayIH->wireCapCol * writeVoltageLTP * writeVoltageLTP * (param->nHide-numBatchWriteSynapse);   // Unselected SLs (LTP phase)
-									// No LTD part because all unselected rows and columns are V=0
-								} else {
-									sumArrayWriteEnergy += arrayIH->wireCapRow * writeVoltageLTP * writeVoltageLTP;    // Selected WL (LTP phase)
-									sumArrayWriteEnergy += arrayIH->wireCapRow * writeVoltageLTP/2 * writeVoltageLTP/2 * (param->nInput - 1);  // Unselected WLs (LTP phase)
-									sumArrayWriteEnergy += arrayIH->wireCapCol * writeVoltageLTP/2 * writeVoltageLTP/2 * (param->nHide - numBatchWriteSynapse);   // Unselected BLs (LTP phase)
-									sumArrayWriteEnergy += arrayIH->wireCapRow * writeVoltageLTD/2 * writeVoltageLTD/2 * (param->nInput - 1);    // Unselected WLs (LTD phase)
-									sumArrayWriteEnergy += arrayIH->wireCapCol * writeVoltageLTD/2 * writeVoltageLTD/2 * (param->nHide - numBatchWriteSynapse); // Unselected BLs (LTD phase)
+
+								/* generate Delta pulse train */
+								#pragma omp for
+								for (int n = 0; n < param->nHide; n++) {
+									RandomStream random(RandomStreamId(RANDOM_PULSE_DELTA_IH, n), 0);	// Pulse train stream of this delta
+									deltaPulseIH.Generate(n, random, fabs(s1[n] * C));
 								}
-							}
-						}
-						
-                        
-						/* Half-selected cells for eNVM */
-						if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(arrayIH->cell[0][0])) {  // Analog eNVM
-							if (!static_cast<eNVM*>(arrayIH->cell[0][0])->cmosAccess && param->writeEnergyReport) { // Cross-point
-								for (int jj = 0; jj < param->nHide; jj++) { // Half-selected cells in the same row
-									if (jj >= start && jj <= end) { continue; } // Skip the selected cells
-									sumArrayWriteEnergy += (writeVoltageLTP/2 * writeVoltageLTP/2 * static_cast<eNVM*>(arrayIH->cell[jj][k])->conductanceAtHalfVwLTP * maxLatencyLTP + writeVoltageLTD/2 * writeVoltageLTD/2 * static_cast<eNVM*>(arrayIH->cell[jj][k])->conductanceAtHalfVwLTD * maxLatencyLTD);
+
+								/* generate pulse for WU: coincidences of the input and delta trains in the LTP or LTD phase */
+								#pragma omp for
+								for (int n = 0; n < param->nInput; n++) {
+									for (int m = 0; m < param->nHide; m++) {
+										if (InputisPositive[n] ^ DeltaisPositive[m]) { // for LTP
+											pulse[n][m] = CountCoincidence(inputPulseIH.GetLTP(n), deltaPulseIH.GetLTP(m), inputPulseIH.numWords);
+										}
+										else { // for LTD
+											pulse[n][m] = -CountCoincidence(inputPulseIH.GetLTD(n), deltaPulseIH.GetLTD(m), inputPulseIH.numWords);
+										}
+									}
+									worklistIH.Build(n, pulse[n]);	// Worklist of the sparse WU
 								}
-								for (int kk = 0; kk < param->nInput; kk++) {    // Half-selected cells in other rows
-									// Note that here is a bit inaccurate if using OpenMP, because the weight on other rows (threads) are also being updated
-									if (kk == k) { continue; } // Skip the selected row
-									for (int jj = start; jj <= end; jj++) {
-										sumArrayWriteEnergy += (writeVoltageLTP/2 * writeVoltageLTP/2 * static_cast<eNVM*>(arrayIH->cell[jj][kk])->conductanceAtHalfVwLTP * maxLatencyLTP + writeVoltageLTD/2 * writeVoltageLTD/2 * static_cast<eNVM*>(arrayIH->cell[jj][kk])->conductanceAtHalfVwLTD * maxLatencyLTD);
+							}
+							if (replicas->IsActive()) {	/* Every replica writes the pulse counts averaged over the replicas to its own array */
+								#pragma omp single
+								{
+									replicas->AllReduceAverage(pulse[0], (size_t)param->nInput * param->nHide);
+									for (int n = 0; n < param->nInput; n++) {
+										worklistIH.Build(n, pulse[n]);
 									}
 								}
 							}
-						} 
-					}
-					/* Calculate the average number of write pulses on the selected row */
-					#pragma omp critical    // Use critical here since NeuroSim class functions may update its member variables
-					{
-						if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(arrayIH->cell[0][0])) {  // Analog eNVM
-							int sumNumWritePulse = 0;
-							for (int j = 0; j < param->nHide; j++) {
-								sumNumWritePulse += abs(static_cast<AnalogNVM*>(arrayIH->cell[j][k])->numPulse);    // Note that LTD has negative pulse number
+							if (accumulateWU) {
+								#pragma omp for
+								for (int n = 0; n < param->nInput; n++) {
+									pulseSumIH.Add(n, pulse[n]);
+									if (writeSample) {
+										pulseSumIH.Flush(n, pulse[n]);
+										worklistIH.Build(n, pulse[n]);
+									}
+								}
 							}
-							subArrayIH->numWritePulse = sumNumWritePulse / param->nHide;
-							double writeVoltageSquareSumRow = 0;
-							if (param->writeEnergyReport) {
-								if (static_cast<AnalogNVM*>(arrayIH->cell[0][0])->nonIdenticalPulse) { // Non-identical write pulse scheme
-									for (int j = 0; j < param->nHide; j++) {
-										writeVoltageSquareSumRow += static_cast<AnalogNVM*>(arrayIH->cell[j][k])->writeVoltageSquareSum;
+
+							#pragma omp for
+							for (int k = 0; k < param->nInput; k++) {
+								int numWriteOperationPerRow = 0;	// Number of write batches in a row that have any weight change
+								const unsigned short *pulseColumn = worklistIH.GetColumns(k);	// Columns of this row with any pulse, in order
+								int numPulseColumns = worklistIH.GetNumEntries(k);
+								int nextPulseColumn = 0;	// First worklist entry after the previous write batch
+								bool updateSample = optimizerIH->UpdateRow(k, s1, trainSet->GetInput(i, k), batchSize, rowDeltaWeight[k]);	// Weight change of the row, if the weights are updated at this sample
+								WriteLedger &row = ledger[k];
+								row.Clear();
+								if (!writeSample) {	// The optimizer has summed the gradient of the row, and the accumulator its pulse counts
+									continue;
+								}
+								row.written = true;
+								for (int j = 0; j < param->nHide; j+=numBatchWriteSynapse) {
+									/* Batch write */
+									int start = j;
+									int end = j + numBatchWriteSynapse - 1;
+									if (end >= param->nHide) {
+										end = param->nHide - 1;
 									}
-									if (sumNumWritePulse > 0) {	// Prevent division by 0
-										subArrayIH->cell.writeVoltage = sqrt(writeVoltageSquareSumRow / sumNumWritePulse);	// RMS value of write voltage in a row
+									double maxLatencyLTP = 0;	// Max latency for AnalogNVM's LTP or weight increase in this batch write
+									double maxLatencyLTD = 0;	// Max latency for AnalogNVM's LTD or weight decrease in this batch write
+									bool weightChangeBatch = false;	// Specify if there is any weight change in the entire write batch
+									bool writeBatch = true;	// The sparse WU skips the batches without any pulse, whose cells keep their conductance and weight
+									int firstPulseColumn = nextPulseColumn;	// Worklist entries of this batch: firstPulseColumn..nextPulseColumn-1
+									if (sparseWUIH) {
+										writeBatch = (nextPulseColumn < numPulseColumns && pulseColumn[nextPulseColumn] <= end);
+										while (nextPulseColumn < numPulseColumns && pulseColumn[nextPulseColumn] <= end) {
+											nextPulseColumn++;
+										}
+									}
+                        
+			                        double maxWeightUpdated=0;
+			                        double maxPulseNum =0;
+			                        double actualWeightUpdated;
+			                        for (int jj = start; jj <= end; jj++) { // Selected cells
+			                            if (updateSample) {
+			                                deltaWeight1[jj][k] = rowDeltaWeight[k][jj];
+			                            }
+                    
+			                           /* tracking code */
+			                            totalDeltaWeight1[jj][k] += deltaWeight1[jj][k];
+			                            totalDeltaWeight1_abs[jj][k] += fabs(deltaWeight1[jj][k]);
+
+			                            // find the actual weight update
+			                            if(deltaWeight1[jj][k]+weight1[jj][k] > param-> maxWeight)
+			                            {
+			                                actualWeightUpdated=param->maxWeight - weight1[jj][k];    
+			                            }
+			                            else if(deltaWeight1[jj][k]+weight1[jj][k] < param->minWeight)
+			                            {
+			                                actualWeightUpdated=param->minWeight - weight1[jj][k];
+			                            } 
+			                            else actualWeightUpdated=deltaWeight1[jj][k];
+                            
+			                            if(fabs(actualWeightUpdated)>maxWeightUpdated)
+			                            {
+			                                maxWeightUpdated =fabs(actualWeightUpdated);
+			                            }
+									}
+
+									/* The sparse WU writes only the worklist cells of the batch, since the other cells have no pulse */
+									if (updateSample && writeBatch && arrayIH->IsAnalogNVM()) {	// Analog eNVM
+										int numBatchCells = sparseWUIH? nextPulseColumn - firstPulseColumn : end - start + 1;
+										for (int e = 0; e < numBatchCells; e++) {
+											int jj = sparseWUIH? pulseColumn[firstPulseColumn + e] : start + e;	// Selected cell
+											//arrayIH->WriteCell(jj, k, deltaWeight1[jj][k], weight1[jj][k], param->maxWeight, param->minWeight, true);
+
+											//arrayIH->WirteCellWithNum(jj, k, pulse[k][jj], weight1[jj][k], param->maxWeight, param->minWeight);
+
+											arrayIH->WriteCelltest(jj, k, pulse[k][jj], weight1[jj][k], param->maxWeight, param->minWeight);
+
+											weight1[jj][k] = arrayIH->ConductanceToWeight(jj, k, param->maxWeight, param->minWeight);
+											weightChangeBatch = weightChangeBatch || arrayIH->numPulse[arrayIH->CellIndex(jj, k)];
+											if(fabs(arrayIH->numPulse[arrayIH->CellIndex(jj, k)]) > maxPulseNum)
+											{
+												maxPulseNum=fabs(arrayIH->numPulse[arrayIH->CellIndex(jj, k)]);
+											}
+											/* Get maxLatencyLTP and maxLatencyLTD */
+											if (arrayIH->writeLatencyLTP[arrayIH->CellIndex(jj, k)] > maxLatencyLTP)
+												maxLatencyLTP = arrayIH->writeLatencyLTP[arrayIH->CellIndex(jj, k)];
+											if (arrayIH->writeLatencyLTD[arrayIH->CellIndex(jj, k)] > maxLatencyLTD)
+												maxLatencyLTD = arrayIH->writeLatencyLTD[arrayIH->CellIndex(jj, k)];
+										}
+									}
+			                        // update the track variables
+			                        row.weightUpdate += maxWeightUpdated;
+			                        row.numPulse += maxPulseNum;
+                        
+									numWriteOperationPerRow += weightChangeBatch;
+									if (arrayIH->IsAnalogNVM() && writeBatch) {  // Analog eNVM
+										/* Set the max latency for all the selected cells in this batch */
+										if (!sparseWUIH) {
+											for (int jj = start; jj <= end; jj++) { // Selected cells
+												arrayIH->SetWriteLatency(jj, k, maxLatencyLTP, maxLatencyLTD);
+											}
+										} else {
+											for (int e = firstPulseColumn; e < nextPulseColumn; e++) {
+												arrayIH->SetWriteLatency(pulseColumn[e], k, maxLatencyLTP, maxLatencyLTD);
+											}
+											if (batchWriteEnergy) {	// The cells off the worklist are half-selected, and only the batch write energy needs their state
+												int e = firstPulseColumn;
+												for (int jj = start; jj <= end; jj++) {
+													if (e < nextPulseColumn && pulseColumn[e] == jj) {
+														e++;
+													} else {
+														arrayIH->SetHalfSelected(jj, k, maxLatencyLTP, maxLatencyLTD);
+													}
+												}
+											}
+										}
+									}
+                        
+									/* Latency for each batch write in Analog eNVM */
+									if (arrayIH->IsAnalogNVM()) {	// Analog eNVM
+										row.writeLatencyAnalogNVM += maxLatencyLTP + maxLatencyLTD;
+									}
+                        
+									/* Energy consumption on the cells and array caps for eNVM */
+									if (batchWriteEnergy) {
+										batchWriteEnergy(layerWrite, k, start, end, maxLatencyLTP, maxLatencyLTD, weightChangeBatch, writeBatch, row);
+									}
+								}
+								/* Calculate the average number of write pulses on the selected row */
+								if (arrayIH->IsAnalogNVM()) {  // Analog eNVM
+									int sumNumWritePulse = 0;
+									if (sparseWUIH) {	// The cells off the worklist were not written
+										for (int e = 0; e < numPulseColumns; e++) {
+											sumNumWritePulse += abs(arrayIH->numPulse[arrayIH->CellIndex(pulseColumn[e], k)]);
+										}
 									} else {
-										subArrayIH->cell.writeVoltage = 0;
+										for (int j = 0; j < param->nHide; j++) {
+											sumNumWritePulse += abs(arrayIH->numPulse[arrayIH->CellIndex(j, k)]);    // Note that LTD has negative pulse number
+										}
+									}
+									row.numWritePulse = sumNumWritePulse / param->nHide;
+									double writeVoltageSquareSumRow = 0;
+									if (batchWriteEnergy) {
+										if (layerWrite.nonIdenticalPulse) { // Non-identical write pulse scheme
+											if (sparseWUIH) {
+												for (int e = 0; e < numPulseColumns; e++) {
+													writeVoltageSquareSumRow += static_cast<AnalogNVM*>(arrayIH->cell[pulseColumn[e]][k])->writeVoltageSquareSum;
+												}
+											} else {
+												for (int j = 0; j < param->nHide; j++) {
+													writeVoltageSquareSumRow += static_cast<AnalogNVM*>(arrayIH->cell[j][k])->writeVoltageSquareSum;
+												}
+											}
+											if (sumNumWritePulse > 0) {	// Prevent division by 0
+												row.writeVoltage = sqrt(writeVoltageSquareSumRow / sumNumWritePulse);	// RMS value of write voltage in a row
+											} else {
+												row.writeVoltage = 0;
+											}
+										}
 									}
 								}
+								row.numWriteOperation = numWriteOperationPerRow;
 							}
 						}
-                        
-						numWriteCellPerOperation = (double)numWriteCellPerOperation/numWriteOperationPerRow;
-						sumNeuroSimWriteEnergy += NeuroSimSubArrayWriteEnergy(subArrayIH, numWriteOperationPerRow, numWriteCellPerOperation);
-
-					}
-					numWriteOperation += numWriteOperationPerRow;
-                    sumNeuroSimWriteEnergy += NeuroSimSubArrayWriteEnergy(subArrayIH, numWriteOperationPerRow, numWriteCellPerOperation);
-				}
 
-				#pragma omp parallel for
-					for (int n = 0; n < param->nInput; n++) {
-						delete[] pulse[n];
-					}
-					delete[] pulse;
-
-				if(!std::isnan(sumArrayWriteEnergy)){
-    				arrayIH->writeEnergy += sumArrayWriteEnergy;
-				}				
-				subArrayIH->writeDynamicEnergy += sumNeuroSimWriteEnergy;
-				numWriteOperation = numWriteOperation / param->nInput;
-				subArrayIH->writeLatency += NeuroSimSubArrayWriteLatency(subArrayIH, numWriteOperation, sumWriteLatencyAnalogNVM);
-			} else {
-				#pragma omp parallel for
-				for (int j = 0; j < param->nHide; j++) {
-					for (int k = 0; k < param->nInput; k++) {
-						deltaWeight1[j][k] = - param->alpha1 * s1[j] * Input[i][k];
-						weight1[j][k] = weight1[j][k] + deltaWeight1[j][k];
-						if (weight1[j][k] > param->maxWeight) {
-							deltaWeight1[j][k] -= weight1[j][k] - param->maxWeight;
-							weight1[j][k] = param->maxWeight;
-						} else if (weight1[j][k] < param->minWeight) {
-							deltaWeight1[j][k] += param->minWeight - weight1[j][k];
-							weight1[j][k] = param->minWeight;
+						/* Merge the row ledgers in row order. The NeuroSim write energy of each row is computed here, since NeuroSim class functions update the members of subArrayIH */
+						WriteLedger &total = layerWriteIH;
+						for (int k = 0; k < param->nInput; k++) {
+							WriteLedger &row = ledger[k];
+							if (!row.written) {
+								continue;
+							}
+							arrayIH->MergeColumnHalfVw(k);
+							if (row.numWritePulse >= 0) {
+								subArrayIH->numWritePulse = row.numWritePulse;
+							}
+							if (row.writeVoltage >= 0) {
+								subArrayIH->cell.writeVoltage = row.writeVoltage;
+							}
+							/* The average number of write cells per operation (for digital eNVM) is not tracked here, so it is passed as 0 */
+							row.neuroSimWriteEnergy += NeuroSimSubArrayWriteEnergy(subArrayIH, row.numWriteOperation, 0);
+							total.Add(row);
+						}
+						arrayIH->DeferColumnHalfVw(false);
+
+						workspace.Reset(sampleMark);
+						sparseWUIH = arrayIH->deviceType == REAL_DEVICE && arrayIH->cachedReadCurrent && optimizerIH->UpdateEverySample();
+
+						if(!std::isnan(total.arrayWriteEnergy)){
+		    				arrayIH->writeEnergy += total.arrayWriteEnergy;
+						}				
+						subArrayIH->writeDynamicEnergy += total.neuroSimWriteEnergy;
+						double numWriteOperation = (double)total.numWriteOperation / param->nInput;	// Average number of write batches in the whole array
+						if (writeSample) {
+							subArrayIH->writeLatency += NeuroSimSubArrayWriteLatency(subArrayIH, numWriteOperation, total.writeLatencyAnalogNVM);
+						}
+					} else {
+						double **gradient = NULL;	// Weight change averaged over the replicas
+						if (replicas->IsActive()) {
+							gradient = workspace.AllocateMatrix<double>(param->nHide, param->nInput);
+							for (int j = 0; j < param->nHide; j++) {
+								for (int k = 0; k < param->nInput; k++) {
+									gradient[j][k] = - param->alpha1 * s1[j] * trainSet->GetInput(i, k) / replicas->numReplicas;
+								}
+							}
+							replicas->AllReduce(gradient[0], (size_t)param->nHide * param->nInput);
 						}
-						if (param->useHardwareInTrainingFF) {
-							arrayIH->WriteCell(j, k, deltaWeight1[j][k], weight1[j][k], param->maxWeight, param->minWeight, false);
+						#pragma omp parallel for copyin(randomPhase)
+						for (int j = 0; j < param->nHide; j++) {
+							for (int k = 0; k < param->nInput; k++) {
+								deltaWeight1[j][k] = gradient? gradient[j][k] : - param->alpha1 * s1[j] * trainSet->GetInput(i, k);
+								weight1[j][k] = weight1[j][k] + deltaWeight1[j][k];
+								if (weight1[j][k] > param->maxWeight) {
+									deltaWeight1[j][k] -= weight1[j][k] - param->maxWeight;
+									weight1[j][k] = param->maxWeight;
+								} else if (weight1[j][k] < param->minWeight) {
+									deltaWeight1[j][k] += param->minWeight - weight1[j][k];
+									weight1[j][k] = param->minWeight;
+								}
+								if (param->useHardwareInTrainingFF) {
+									arrayIH->WriteCell(j, k, deltaWeight1[j][k], weight1[j][k], param->maxWeight, param->minWeight, false);
+								}
+							}
 						}
+						workspace.Reset(sampleMark);
 					}
 				}
-			}
-
-			/* Update weight of the second layer (hidden layer to the output layer) */
-			if (param->useHardwareInTrainingWU) {
-				double sumArrayWriteEnergy = 0;   // Use a temporary variable here since OpenMP does not support reduction on class member
-				double sumNeuroSimWriteEnergy = 0;   // Use a temporary variable here since OpenMP does not support reduction on class member
-				double sumWriteLatencyAnalogNVM = 0;	// Use a temporary variable here since OpenMP does not support reduction on class member
-				double numWriteOperation = 0;	// Average number of write batches in the whole array. Use a temporary variable here since OpenMP does not support reduction on class member
-                double writeVoltageLTP;
-                double writeVoltageLTD;
-                double writePulseWidthLTP;
-                double writePulseWidthLTD;				
-                if(eNVM *temp = dynamic_cast<eNVM*>(arrayHO->cell[0][0])){
-                     writeVoltageLTP = static_cast<eNVM*>(arrayHO->cell[0][0])->writeVoltageLTP;
-				     writeVoltageLTD = static_cast<eNVM*>(arrayHO->cell[0][0])->writeVoltageLTD;
-				     writePulseWidthLTP = static_cast<eNVM*>(arrayHO->cell[0][0])->writePulseWidthLTP;
-				     writePulseWidthLTD = static_cast<eNVM*>(arrayHO->cell[0][0])->writePulseWidthLTD;
-                }
-                
-				numBatchWriteSynapse = (int)ceil((double)arrayHO->arrayColSize / param->numWriteColMuxed);
 
-				/* Stochastic pulse WU */
-				int maxNumLevelLTP = 97;
-				int maxNumLevelLTD = 100;
-				double ProbConstLTP = sqrt((param->alpha2 / (pow(2, t/10)) * maxNumLevelLTP) / (param->StreamLength * (param->maxWeight - param->minWeight)));
-				double ProbConstLTD = sqrt((param->alpha2 / (pow(2, t/10)) * maxNumLevelLTD) / (param->StreamLength * (param->maxWeight - param->minWeight)));
+				/* Update weight of the second layer (hidden layer to the output layer) */
+				#pragma omp task if(concurrentWU)
+				{
+					omp_set_num_threads(numThreadsHO);
+					if (param->useHardwareInTrainingWU) {
+						int numBatchWriteSynapse = (int)ceil((double)arrayHO->arrayColSize / param->numWriteColMuxed);
+
+						/* Stochastic pulse WU */
+						int maxNumLevelLTP = 97;
+						int maxNumLevelLTD = 100;
+						double ProbConstLTP = sqrt((param->alpha2 / (pow(2, t/10)) * maxNumLevelLTP) / (param->StreamLength * (param->maxWeight - param->minWeight)));
+						double ProbConstLTD = sqrt((param->alpha2 / (pow(2, t/10)) * maxNumLevelLTD) / (param->StreamLength * (param->maxWeight - param->minWeight)));
 				
-				double C = sqrt((param->alpha1 / (pow(2, t/10))) / (param->StreamLength * 0.001));
+						double C = sqrt((param->alpha1 / (pow(2, t/10))) / (param->StreamLength * 0.001));
+
+						int **pulse = workspaceHO.AllocateMatrix<int>(param->nHide, param->nOutput);
+
+						bool *InputisPositive = workspaceHO.Allocate<bool>(param->nHide);
+						bool *DeltaisPositive = workspaceHO.Allocate<bool>(param->nOutput);
+						double **rowDeltaWeight = workspaceHO.AllocateMatrix<double>(param->nHide, param->nOutput);	// Weight change from the optimizer, in the order of the WU loop
+						WriteLedger *ledger = workspaceHO.Allocate<WriteLedger>(param->nHide);	// Write counters of each row, merged after the WU loop
+						bool writeSample = !accumulateWU || optimizerHO->IsUpdateSample(batchSize);	// Whether this sample runs the WU loop (only the last sample of a batch in the accumulate-then-write WU)
+						const LayerWrite layerWrite(arrayHO, techHO.vdd, param->nHide, param->nOutput, numBatchWriteSynapse);
+						const BatchWriteEnergyKernel batchWriteEnergy = BatchWriteEnergyOf(layerWrite);
+						arrayHO->DeferColumnHalfVw(true);	// The column sums of the half-selected cells are merged with the ledgers
+
+						/* The phases of the WU share one thread team, and the barriers of the work-sharing loops order them */
+						#pragma omp parallel copyin(randomPhase)
+						{
+							/* Input is Positive? or not */
+							#pragma omp for nowait
+								for (int n = 0; n < param->nHide; n++) {
+									InputisPositive[n] = (a1[n] > 0);
+								}
 
-				int **pulse = new int *[param->nHide];
-				#pragma omp parallel for
-				for (int n = 0; n < param->nHide; n++) {
-					pulse[n] = new int[param->nOutput];
-				}
+							/* Delta is Positive? or not */
+							#pragma omp for
+								for (int n = 0; n < param->nOutput; n++) {
+									DeltaisPositive[n] = (s2[n] > 0);
+								}
+				
+							if (param->binomialPulseWU) {
+								/* draw the pulse count of each cell: the input and delta slots coincide with probability p_input*p_delta in each of the StreamLength slots */
+								#pragma omp for
+								for (int n = 0; n < param->nHide; n++) {
+									for (int m = 0; m < param->nOutput; m++) {
+										double pInput = std::min(1.0, fabs(a1[n] * C));
+										double pDelta = std::min(1.0, fabs(s2[m] * C));
+										int count = 0;
+										if (pInput > 0 && pDelta > 0) {
+											RandomStream random(RandomStreamId(RANDOM_PULSE_COUNT_HO, n * param->nOutput + m), 0);	// Pulse count stream of this cell
+											std::binomial_distribution<int> dis(param->StreamLength, pInput * pDelta);
+											count = dis(random);
+										}
+										pulse[n][m] = (InputisPositive[n] ^ DeltaisPositive[m])? count : -count;	// LTP : weight increase or LTD : weight decrease
+									}
+									worklistHO.Build(n, pulse[n]);	// Worklist of the sparse WU
+								}
+							} else {
+								/* generate Input pulse Train */
+								#pragma omp for nowait
+								for (int n = 0; n < param->nHide; n++) {
+									RandomStream random(RandomStreamId(RANDOM_PULSE_INPUT_HO, n), 0);	// Pulse train stream of this input
+									inputPulseHO.Generate(n, random, fabs(a1[n] * C));
+								}
 
-				#pragma omp parallel for collapse(2)
-				for (int n = 0; n < param->nHide; n++) {
-					for (int m = 0; m < param->nOutput; m++) {
-						pulse[n][m] = 0;
-					}
-				}
+								/* generate Delta pulse train */
+								#pragma omp for
+								for (int n = 0; n < param->nOutput; n++) {
+									RandomStream random(RandomStreamId(RANDOM_PULSE_DELTA_HO, n), 0);	// Pulse train stream of this delta
+									deltaPulseHO.Generate(n, random, fabs(s2[n] * C));
+								}
 
-				/* original code */
-				bool **InputPulseTrain = new bool *[param->nHide];
-				//bool *InputisPositive = new bool [param->nHide];
-				bool InputisPositive[param->nHide] = {};
-				
-				/* Input is Positive? or not */
-				#pragma omp parallel for
-					for (int n = 0; n < param->nHide; n++) {
-						if (a1[n] > 0)
-							InputisPositive[n] = 1;
-					}
-				
-				/* generate Input pulse Train */
-				#pragma omp parallel for
-					for (int n = 0; n < param->nHide; n++) {
-						InputPulseTrain[n] = new bool [2 * param->StreamLength];
-
-						double iLTP = fabs(a1[n] * C);
-						double iLTD = fabs(a1[n] * C);
-						std::bernoulli_distribution disLTP(iLTP);
-						std::bernoulli_distribution disLTD(iLTD);
-						for (int t = 0; t < param->StreamLength; t++) {
-							InputPulseTrain[n][t] = disLTP(gen);
-							InputPulseTrain[n][t + param->StreamLength] = disLTD(gen);
-						}
-					}
-				
-				bool **DeltaPulseTrain = new bool *[param->nOutput];
-				//bool *DeltaisPositive = new bool [param->nOutput];
-				bool DeltaisPositive[param->nOutput] = {};
-
-				/* Delta is Positive? or not */
-				#pragma omp parallel for
-					for (int n = 0; n < param->nOutput; n++) {
-						if (s2[n] > 0)
-							DeltaisPositive[n] = 1;
-					}
-				
-				/* generate Delta pulse train */
-				#pragma omp parallel for
-					for (int n = 0; n < param->nOutput; n++) {
-						DeltaPulseTrain[n] = new bool [2 * param->StreamLength];
-
-						double dLTP = fabs(s2[n] * C);
-						double dLTD = fabs(s2[n] * C);
-						std::bernoulli_distribution disLTP(dLTP);
-						std::bernoulli_distribution disLTD(dLTD);
-						for (int t = 0; t < param->StreamLength; t++) {
-							DeltaPulseTrain[n][t] = disLTP(gen);
-							DeltaPulseTrain[n][t + param->StreamLength] = disLTD(gen);
-						}
-					}
-				
-				/* generate pulse for WU */
-				#pragma omp parallel for collapse(3)
-					for (int t = 0; t < param->StreamLength; t++) {
-						for (int n = 0; n < param->nHide; n++) {
-							for (int m = 0; m < param->nOutput; m++) {
-								if (InputisPositive[n] ^ DeltaisPositive[m]) { // for LTP : weight increase
-									if (InputPulseTrain[n][t] & DeltaPulseTrain[m][t])
-										pulse[n][m]++;
+								/* generate pulse for WU: coincidences of the input and delta trains in the LTP or LTD phase */
+								#pragma omp for
+								for (int n = 0; n < param->nHide; n++) {
+									for (int m = 0; m < param->nOutput; m++) {
+										if (InputisPositive[n] ^ DeltaisPositive[m]) { // for LTP : weight increase
+											pulse[n][m] = CountCoincidence(inputPulseHO.GetLTP(n), deltaPulseHO.GetLTP(m), inputPulseHO.numWords);
+										}
+										else { // for LTD : weight decrease
+											pulse[n][m] = -CountCoincidence(inputPulseHO.GetLTD(n), deltaPulseHO.GetLTD(m), inputPulseHO.numWords);
+										}
+									}
+									worklistHO.Build(n, pulse[n]);	// Worklist of the sparse WU
 								}
-								else { // for LTD : weight decrease
-									if (InputPulseTrain[n][t + param->StreamLength] & DeltaPulseTrain[m][t + param->StreamLength])
-										pulse[n][m]--;
+							}
+							if (replicas->IsActive()) {	/* Every replica writes the pulse counts averaged over the replicas to its own array */
+								#pragma omp single
+								{
+									replicas->AllReduceAverage(pulse[0], (size_t)param->nHide * param->nOutput);
+									for (int n = 0; n < param->nHide; n++) {
+										worklistHO.Build(n, pulse[n]);
+									}
+								}
+							}
+							if (accumulateWU) {
+								#pragma omp for
+								for (int n = 0; n < param->nHide; n++) {
+									pulseSumHO.Add(n, pulse[n]);
+									if (writeSample) {
+										pulseSumHO.Flush(n, pulse[n]);
+										worklistHO.Build(n, pulse[n]);
+									}
 								}
 							}
-						}
-					}
 
-				#pragma omp parallel for
-					for (int n = 0; n < param->nHide; n++) 
-						delete[] InputPulseTrain[n];
-					delete[] InputPulseTrain;
-					//delete[] InputisPositive;
-				
-				#pragma omp parallel for
-					for (int n = 0; n < param->nOutput; n++)
-						delete[] DeltaPulseTrain[n];
-					delete[] DeltaPulseTrain;
-					//delete[] DeltaisPositive;
-
-				#pragma omp parallel for reduction(+: sumArrayWriteEnergy, sumNeuroSimWriteEnergy, sumWriteLatencyAnalogNVM)
-				for (int k = 0; k < param->nHide; k++) {
-					int numWriteOperationPerRow = 0;    // Number of write batches in a row that have any weight change
-					int numWriteCellPerOperation = 0;   // Average number of write cells per batch in a row (for digital eNVM)
-					for (int j = 0; j < param->nOutput; j+=numBatchWriteSynapse) {
-						/* Batch write */
-						int start = j;
-						int end = j + numBatchWriteSynapse - 1;
-						if (end >= param->nOutput) {
-							end = param->nOutput - 1;
-						}
-						double maxLatencyLTP = 0;   // Max latency for AnalogNVM's LTP or weight increase in this batch write
-						double maxLatencyLTD = 0;   // Max latency for AnalogNVM's LTD or weight decrease in this batch write
-						bool weightChangeBatch = false; // Specify if there is any weight change in the entire write batch
+
+							#pragma omp for
+							for (int k = 0; k < param->nHide; k++) {
+								int numWriteOperationPerRow = 0;    // Number of write batches in a row that have any weight change
+								const unsigned short *pulseColumn = worklistHO.GetColumns(k);	// Columns of this row with any pulse, in order
+								int numPulseColumns = worklistHO.GetNumEntries(k);
+								int nextPulseColumn = 0;	// First worklist entry after the previous write batch
+								bool updateSample = optimizerHO->UpdateRow(k, s2, a1[k], batchSize, rowDeltaWeight[k]);	// Weight change of the row, if the weights are updated at this sample
+								WriteLedger &row = ledger[k];
+								row.Clear();
+								if (!writeSample) {	// The optimizer has summed the gradient of the row, and the accumulator its pulse counts
+									continue;
+								}
+								row.written = true;
+								for (int j = 0; j < param->nOutput; j+=numBatchWriteSynapse) {
+									/* Batch write */
+									int start = j;
+									int end = j + numBatchWriteSynapse - 1;
+									if (end >= param->nOutput) {
+										end = param->nOutput - 1;
+									}
+									double maxLatencyLTP = 0;   // Max latency for AnalogNVM's LTP or weight increase in this batch write
+									double maxLatencyLTD = 0;   // Max latency for AnalogNVM's LTD or weight decrease in this batch write
+									bool weightChangeBatch = false; // Specify if there is any weight change in the entire write batch
+									bool writeBatch = true;	// The sparse WU skips the batches without any pulse, whose cells keep their conductance and weight
+									int firstPulseColumn = nextPulseColumn;	// Worklist entries of this batch: firstPulseColumn..nextPulseColumn-1
+									if (sparseWUHO) {
+										writeBatch = (nextPulseColumn < numPulseColumns && pulseColumn[nextPulseColumn] <= end);
+										while (nextPulseColumn < numPulseColumns && pulseColumn[nextPulseColumn] <= end) {
+											nextPulseColumn++;
+										}
+									}
                         
-                        double maxWeightUpdated=0;
-                        double maxPulseNum =0;
-                        double actualWeightUpdated=0;
-                        for (int jj = start; jj <= end; jj++) { // Selected cells
-
-							// deltaWeight2[jj][k] = -param->alpha2 * s2[jj] * a1[k];
-                            gradt = s2[jj] * a1[k];
-                            gradSum2[jj][k] += gradt; // sum over the gradient over all the training samples in this batch
-                         if (optimization_type == "SGD") 
-                            deltaWeight2[jj][k] = SGD(gradt, param->alpha2); 
-                         else if((batchSize+1) % train_batchsize == 0){
-                            gradSum2[jj][k] /= train_batchsize;
-                            if(optimization_type=="Momentum")
-                            {
-                                gradSum2[jj][k] *= train_batchsize;
-                                deltaWeight2[jj][k] = Momentum(gradSum2[jj][k], param->alpha2,momentumPrev2[jj][k]);
-                                momentumPrev2[jj][k] = GAMA*momentumPrev2[jj][k]+(1-GAMA)*gradSum2[jj][k];
-                            }
-                            else if(optimization_type=="RMSprop")
-                            {
-                                deltaWeight2[jj][k] = RMSprop(gradSum2[jj][k], param->alpha2, gradSquarePrev2[jj][k]);
-                                gradSquarePrev2[jj][k] = GAMA*gradSquarePrev2[jj][k]+(1-GAMA)*pow(gradSum2[jj][k], 2);
-                            }
-                            else if(optimization_type == "Adam")
-                            {
-                                deltaWeight2[jj][k] = Adam(gradSum2[jj][k], param->alpha2, momentumPrev2[jj][k], gradSquarePrev2[jj][k],(batchSize+1)/train_batchsize);
-                                momentumPrev2[jj][k] = BETA1*momentumPrev2[jj][k]+(1-BETA1)*gradSum2[jj][k];
-                                gradSquarePrev2[jj][k] = BETA2*gradSquarePrev2[jj][k]+(1-BETA2)*pow(gradSum2[jj][k], 2);
-                            }
-                            else std::cout<<"please specify an optimization method" <<end;
-                            gradSum2[jj][k] = 0;
-                        }
-                            /*tracking code*/
-                            totalDeltaWeight2[jj][k] += deltaWeight2[jj][k];
-                            totalDeltaWeight2_abs[jj][k] += fabs(deltaWeight2[jj][k]);
+			                        double maxWeightUpdated=0;
+			                        double maxPulseNum =0;
+			                        double actualWeightUpdated=0;
+			                        for (int jj = start; jj <= end; jj++) { // Selected cells
+
+			                            if (updateSample) {
+			                                deltaWeight2[jj][k] = rowDeltaWeight[k][jj];
+			                            }
+			                            /*tracking code*/
+			                            totalDeltaWeight2[jj][k] += deltaWeight2[jj][k];
+			                            totalDeltaWeight2_abs[jj][k] += fabs(deltaWeight2[jj][k]);
                           
-                            /* track the number of weight update*/
-                            // find the actual weight update
-                            if(deltaWeight2[jj][k]+weight2[jj][k] > param-> maxWeight)
-                            {
-                                actualWeightUpdated=param->maxWeight - weight2[jj][k];    
-                            }
-                            else if(deltaWeight2[jj][k]+weight2[jj][k] < param->minWeight)
-                            {
-                                actualWeightUpdated=param->minWeight - weight2[jj][k];
-                            } 
-                            else actualWeightUpdated=deltaWeight2[jj][k];
+			                            /* track the number of weight update*/
+			                            // find the actual weight update
+			                            if(deltaWeight2[jj][k]+weight2[jj][k] > param-> maxWeight)
+			                            {
+			                                actualWeightUpdated=param->maxWeight - weight2[jj][k];    
+			                            }
+			                            else if(deltaWeight2[jj][k]+weight2[jj][k] < param->minWeight)
+			                            {
+			                                actualWeightUpdated=param->minWeight - weight2[jj][k];
+			                            } 
+			                            else actualWeightUpdated=deltaWeight2[jj][k];
                             
-                            if(fabs(actualWeightUpdated)>maxWeightUpdated)
-                            {
-                                maxWeightUpdated =fabs(actualWeightUpdated);
-                            }		
-                        if(optimization_type == "SGD" || (batchSize+1) % train_batchsize == 0){
-							if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(arrayHO->cell[jj][k])) { // Analog eNVM
-                                // arrayHO->WriteCell(jj, k, deltaWeight2[jj][k], weight2[jj][k], param->maxWeight, param->minWeight, true);
-
-								//arrayHO->WirteCellWithNum(jj, k, pulse[k][jj], weight2[jj][k], param->maxWeight, param->minWeight);
-
-								arrayHO->WriteCelltest(jj, k, pulse[k][jj], weight2[jj][k], param->maxWeight, param->minWeight);
-
-							    weight2[jj][k] = arrayHO->ConductanceToWeight(jj, k, param->maxWeight, param->minWeight);
-								weightChangeBatch = weightChangeBatch || static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->numPulse;
-                                if(fabs(static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->numPulse) > maxPulseNum)
-                                {
-                                    maxPulseNum=fabs(static_cast<AnalogNVM*>(arrayIH->cell[jj][k])->numPulse);
-                                }
-                                /* Get maxLatencyLTP and maxLatencyLTD */
-								if (static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->writeLatencyLTP > maxLatencyLTP)
-									maxLatencyLTP = static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->writeLatencyLTP;
-								if (static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->writeLatencyLTD > maxLatencyLTD)
-									maxLatencyLTD = static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->writeLatencyLTD;
-							}
-                           
-						}
-                        }
-                        totalWeightUpdate += maxWeightUpdated;
-                        totalNumPulse += maxPulseNum;
+			                            if(fabs(actualWeightUpdated)>maxWeightUpdated)
+			                            {
+			                                maxWeightUpdated =fabs(actualWeightUpdated);
+			                            }		
+			                        }
+
+									/* The sparse WU writes only the worklist cells of the batch, since the other cells have no pulse */
+									if (updateSample && writeBatch && arrayHO->IsAnalogNVM()) { // Analog eNVM
+										int numBatchCells = sparseWUHO? nextPulseColumn - firstPulseColumn : end - start + 1;
+										for (int e = 0; e < numBatchCells; e++) {
+											int jj = sparseWUHO? pulseColumn[firstPulseColumn + e] : start + e;	// Selected cell
+											// arrayHO->WriteCell(jj, k, deltaWeight2[jj][k], weight2[jj][k], param->maxWeight, param->minWeight, true);
+
+											//arrayHO->WirteCellWithNum(jj, k, pulse[k][jj], weight2[jj][k], param->maxWeight, param->minWeight);
+
+											arrayHO->WriteCelltest(jj, k, pulse[k][jj], weight2[jj][k], param->maxWeight, param->minWeight);
+
+											weight2[jj][k] = arrayHO->ConductanceToWeight(jj, k, param->maxWeight, param->minWeight);
+											weightChangeBatch = weightChangeBatch || arrayHO->numPulse[arrayHO->CellIndex(jj, k)];
+											if(fabs(arrayHO->numPulse[arrayHO->CellIndex(jj, k)]) > maxPulseNum)
+											{
+												maxPulseNum=fabs(arrayHO->numPulse[arrayHO->CellIndex(jj, k)]);
+											}
+											/* Get maxLatencyLTP and maxLatencyLTD */
+											if (arrayHO->writeLatencyLTP[arrayHO->CellIndex(jj, k)] > maxLatencyLTP)
+												maxLatencyLTP = arrayHO->writeLatencyLTP[arrayHO->CellIndex(jj, k)];
+											if (arrayHO->writeLatencyLTD[arrayHO->CellIndex(jj, k)] > maxLatencyLTD)
+												maxLatencyLTD = arrayHO->writeLatencyLTD[arrayHO->CellIndex(jj, k)];
+										}
+									}
+			                        row.weightUpdate += maxWeightUpdated;
+			                        row.numPulse += maxPulseNum;
+                        
+			                        /* Latency for each batch write in Analog eNVM */
+									numWriteOperationPerRow += weightChangeBatch;
+									if (arrayHO->IsAnalogNVM() && writeBatch) {  // Analog eNVM
+										/* Set the max latency for all the selected cells in this batch */
+										if (!sparseWUHO) {
+											for (int jj = start; jj <= end; jj++) { // Selected cells
+												arrayHO->SetWriteLatency(jj, k, maxLatencyLTP, maxLatencyLTD);
+											}
+										} else {
+											for (int e = firstPulseColumn; e < nextPulseColumn; e++) {
+												arrayHO->SetWriteLatency(pulseColumn[e], k, maxLatencyLTP, maxLatencyLTD);
+											}
+											if (batchWriteEnergy) {	// The cells off the worklist are half-selected, and only the batch write energy needs their state
+												int e = firstPulseColumn;
+												for (int jj = start; jj <= end; jj++) {
+													if (e < nextPulseColumn && pulseColumn[e] == jj) {
+														e++;
+													} else {
+														arrayHO->SetHalfSelected(jj, k, maxLatencyLTP, maxLatencyLTD);
+													}
+												}
+											}
+										}
+									}
+                        
+									/* Latency for each batch write in Analog eNVM */
+									if (arrayHO->IsAnalogNVM()) {	// Analog eNVM
+										row.writeLatencyAnalogNVM += maxLatencyLTP + maxLatencyLTD;
+									}
                         
-                        /* Latency for each batch write in Analog eNVM */
-						numWriteOperationPerRow += weightChangeBatch;
-						for (int jj = start; jj <= end; jj++) { // Selected cells
-							if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(arrayHO->cell[0][0])) {  // Analog eNVM
-								/* Set the max latency for all the cells in this batch */
-								static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->writeLatencyLTP = maxLatencyLTP;
-								static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->writeLatencyLTD = maxLatencyLTD;
-								if (param->writeEnergyReport && weightChangeBatch) {
-									if (static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->nonIdenticalPulse) { // Non-identical write pulse scheme
-										if (static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->numPulse > 0) {  // LTP
-											static_cast<eNVM*>(arrayHO->cell[jj][k])->writeVoltageLTP = sqrt(static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->writeVoltageSquareSum / static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->numPulse);   // RMS value of LTP write voltage
-											static_cast<eNVM*>(arrayHO->cell[jj][k])->writeVoltageLTD = static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->VinitLTD + 0.5 * static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->VstepLTD * static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->maxNumLevelLTD;    // Use average voltage of LTD write voltage
-										} else if (static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->numPulse < 0) {    // LTD
-											static_cast<eNVM*>(arrayHO->cell[jj][k])->writeVoltageLTP = static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->VinitLTP + 0.5 * static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->VstepLTP * static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->maxNumLevelLTP;    // Use average voltage of LTP write voltage
-											static_cast<eNVM*>(arrayHO->cell[jj][k])->writeVoltageLTD = sqrt(static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->writeVoltageSquareSum / (-1*static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->numPulse));    // RMS value of LTD write voltage
-										} else {	// Half-selected during LTP and LTD phases
-											static_cast<eNVM*>(arrayHO->cell[jj][k])->writeVoltageLTP = static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->VinitLTP + 0.5 * static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->VstepLTP * static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->maxNumLevelLTP;    // Use average voltage of LTP write voltage
-											static_cast<eNVM*>(arrayHO->cell[jj][k])->writeVoltageLTD = static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->VinitLTD + 0.5 * static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->VstepLTD * static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->maxNumLevelLTD;    // Use average voltage of LTD write voltage
+									/* Energy consumption on the cells and array caps for eNVM */
+									if (batchWriteEnergy) {
+										batchWriteEnergy(layerWrite, k, start, end, maxLatencyLTP, maxLatencyLTD, weightChangeBatch, writeBatch, row);
+									}
+								}
+								/* Calculate the average number of write pulses on the selected row */
+								if (arrayHO->IsAnalogNVM()) {  // Analog eNVM
+									int sumNumWritePulse = 0;
+									if (sparseWUHO) {	// The cells off the worklist were not written
+										for (int e = 0; e < numPulseColumns; e++) {
+											sumNumWritePulse += abs(arrayHO->numPulse[arrayHO->CellIndex(pulseColumn[e], k)]);
+										}
+									} else {
+										for (int j = 0; j < param->nOutput; j++) {
+											sumNumWritePulse += abs(arrayHO->numPulse[arrayHO->CellIndex(j, k)]);    // Note that LTD has negative pulse number
+										}
+									}
+									row.numWritePulse = sumNumWritePulse / param->nOutput;
+									double writeVoltageSquareSumRow = 0;
+									if (batchWriteEnergy) {
+										if (layerWrite.nonIdenticalPulse) { // Non-identical write pulse scheme
+											if (sparseWUHO) {
+												for (int e = 0; e < numPulseColumns; e++) {
+													writeVoltageSquareSumRow += static_cast<AnalogNVM*>(arrayHO->cell[pulseColumn[e]][k])->writeVoltageSquareSum;
+												}
+											} else {
+												for (int j = 0; j < param->nOutput; j++) {
+													writeVoltageSquareSumRow += static_cast<AnalogNVM*>(arrayHO->cell[j][k])->writeVoltageSquareSum;
+												}
+											}
+											if (sumNumWritePulse > 0) {	// Prevent division by 0
+												row.writeVoltage = sqrt(writeVoltageSquareSumRow / sumNumWritePulse);  // RMS value of write voltage in a row
+											} else {
+												row.writeVoltage = 0;
+											}
 										}
+		                                else if(arrayHO->IsHybridCell())
+		                                {
+									         int sumNumWritePulse = 0;
+									         for (int j = 0; j < param->nHide; j++) {
+										           sumNumWritePulse += abs(static_cast<HybridCell*>(arrayHO->cell[j][k])->LSBcell.numPulse);    // Note that LTD has negative pulse number
+									          }
+		                                     row.numWritePulse = sumNumWritePulse / param->nHide;
+		                                }
 									}
-									static_cast<AnalogNVM*>(arrayHO->cell[jj][k])->WriteEnergyCalculation(arrayHO->wireCapCol);
-									sumArrayWriteEnergy += static_cast<eNVM*>(arrayHO->cell[jj][k])->writeEnergy;
-                                    if(_2T1F* temp = dynamic_cast<_2T1F*>(arrayHO->cell[jj][k]))
-                                        sumArrayWriteEnergy += static_cast<_2T1F*>(arrayHO->cell[jj][k])->transWriteEnergy;
 								}
+								row.numWriteOperation = numWriteOperationPerRow;
 							}
-                            
 						}
-						/* Latency for each batch write in Analog eNVM */
-						if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(arrayHO->cell[0][0])) {  // Analog eNVM
-							sumWriteLatencyAnalogNVM += maxLatencyLTP + maxLatencyLTD;
+
+						/* Merge the row ledgers in row order (see the first layer) */
+						WriteLedger &total = layerWriteHO;
+						for (int k = 0; k < param->nHide; k++) {
+							WriteLedger &row = ledger[k];
+							if (!row.written) {
+								continue;
+							}
+							arrayHO->MergeColumnHalfVw(k);
+							if (row.numWritePulse >= 0) {
+								subArrayHO->numWritePulse = row.numWritePulse;
+							}
+							if (row.writeVoltage >= 0) {
+								subArrayHO->cell.writeVoltage = row.writeVoltage;
+							}
+							/* The average number of write cells per operation (for digital eNVM) is not tracked here, so it is passed as 0 */
+							row.neuroSimWriteEnergy += NeuroSimSubArrayWriteEnergy(subArrayHO, row.numWriteOperation, 0);
+							total.Add(row);
 						}
-                        else if(HybridCell *temp = dynamic_cast<HybridCell*>(arrayIH->cell[0][0])){ // HybridCell
- 							sumWriteLatencyAnalogNVM += maxLatencyLTP + maxLatencyLTD;
-                        }
-						/* Energy consumption on array caps for eNVM */
-						if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(arrayHO->cell[0][0])) {  // Analog eNVM
-							if (param->writeEnergyReport && weightChangeBatch) {
-								if (static_cast<AnalogNVM*>(arrayHO->cell[0][0])->nonIdenticalPulse) { // Non-identical write pulse scheme
-									writeVoltageLTP = static_cast<AnalogNVM*>(arrayHO->cell[0][0])->VinitLTP + 0.5 * static_cast<AnalogNVM*>(arrayHO->cell[0][0])->VstepLTP * static_cast<AnalogNVM*>(arrayHO->cell[0][0])->maxNumLevelLTP;    // Use average voltage of LTP write voltage
-									writeVoltageLTD = static_cast<AnalogNVM*>(arrayHO->cell[0][0])->VinitLTD + 0.5 * static_cast<AnalogNVM*>(arrayHO->cell[0][0])->VstepLTD * static_cast<AnalogNVM*>(arrayHO->cell[0][0])->maxNumLevelLTD;    // Use average voltage of LTD write voltage
-								}
-								if (static_cast<eNVM*>(arrayHO->cell[0][0])->cmosAccess) {  // 1T1R
-									// The energy on selected SLs is included in WriteCell()
-									sumArrayWriteEnergy += arrayHO->wireGateCapRow * techHO.vdd * techHO.vdd * 2;   // Selected WL (*2 means both LTP and LTD phases)
-									sumArrayWriteEnergy += arrayHO->wireCapRow * writeVoltageLTP * writeVoltageLTP;   // Selected BL (LTP phases)
-									sumArrayWriteEnergy += arrayHO->wireCapCol * writeVoltageLTP * writeVoltageLTP * (param->nOutput-numBatchWriteSynapse);   // Unselected SLs (LTP phase)
-									// No LTD part because all unselected rows and columns are V=0
-								} else {
-									sumArrayWriteEnergy += arrayHO->wireCapRow * writeVoltageLTP * writeVoltageLTP;   // Selected WL (LTP phase)
-									sumArrayWriteEnergy += arrayHO->wireCapRow * writeVoltageLTP/2 * writeVoltageLTP/2 * (param->nHide - 1);    // Unselected WLs (LTP phase)
-									sumArrayWriteEnergy += arrayHO->wireCapCol * writeVoltageLTP/2 * writeVoltageLTP/2 * (param->nOutput - numBatchWriteSynapse); // Unselected BLs (LTP phase)
-									sumArrayWriteEnergy += arrayHO->wireCapRow * writeVoltageLTD/2 * writeVoltageLTD/2 * (param->nHide - 1);    // Unselected WLs (LTD phase)
-									sumArrayWriteEnergy += arrayHO->wireCapCol * writeVoltageLTD/2 * writeVoltageLTD/2 * (param->nOutput - numBatchWriteSynapse); // Unselected BLs (LTD phase)
+						arrayHO->DeferColumnHalfVw(false);
+						arrayHO->writeEnergy += total.arrayWriteEnergy;
+						subArrayHO->writeDynamicEnergy += total.neuroSimWriteEnergy;
+						double numWriteOperation = (double)total.numWriteOperation / param->nHide;	// Average number of write batches in the whole array
+						if (writeSample) {
+							subArrayHO->writeLatency += NeuroSimSubArrayWriteLatency(subArrayHO, numWriteOperation, total.writeLatencyAnalogNVM);
+						}
+
+						workspaceHO.Reset();
+						sparseWUHO = arrayHO->deviceType == REAL_DEVICE && arrayHO->cachedReadCurrent && optimizerHO->UpdateEverySample();
+					} else {
+						double **gradient = NULL;	// Weight change averaged over the replicas
+						if (replicas->IsActive()) {
+							gradient = workspaceHO.AllocateMatrix<double>(param->nOutput, param->nHide);
+							for (int j = 0; j < param->nOutput; j++) {
+								for (int k = 0; k < param->nHide; k++) {
+									gradient[j][k] = -param->alpha2 * s2[j] * a1[k] / replicas->numReplicas;
 								}
 							}
+							replicas->AllReduce(gradient[0], (size_t)param->nOutput * param->nHide);
 						}
-						
-                       
-						/* Half-selected cells for eNVM */
-						if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(arrayHO->cell[0][0])) {  // Analog eNVM
-							if (!static_cast<eNVM*>(arrayHO->cell[0][0])->cmosAccess && param->writeEnergyReport) { // Cross-point
-								for (int jj = 0; jj < param->nOutput; jj++) {    // Half-selected cells in the same row
-									if (jj >= start && jj <= end) { continue; } // Skip the selected cells
-									sumArrayWriteEnergy += (writeVoltageLTP/2 * writeVoltageLTP/2 * static_cast<eNVM*>(arrayHO->cell[jj][k])->conductanceAtHalfVwLTP * maxLatencyLTP + writeVoltageLTD/2 * writeVoltageLTD/2 * static_cast<eNVM*>(arrayHO->cell[jj][k])->conductanceAtHalfVwLTD * maxLatencyLTD);
-								}
-								for (int kk = 0; kk < param->nHide; kk++) { // Half-selected cells in other rows
-									// Note that here is a bit inaccurate if using OpenMP, because the weight on other rows (threads) are also being updated
-									if (kk == k) { continue; }  // Skip the selected row
-									for (int jj = start; jj <= end; jj++) {
-										sumArrayWriteEnergy += (writeVoltageLTP/2 * writeVoltageLTP/2 * static_cast<eNVM*>(arrayHO->cell[jj][kk])->conductanceAtHalfVwLTP * maxLatencyLTP + writeVoltageLTD/2 * writeVoltageLTD/2 * static_cast<eNVM*>(arrayHO->cell[jj][kk])->conductanceAtHalfVwLTD * maxLatencyLTD);
-									}
+						#pragma omp parallel for copyin(randomPhase)
+						for (int j = 0; j < param->nOutput; j++) {
+							for (int k = 0; k < param->nHide; k++) {
+								deltaWeight2[j][k] = gradient? gradient[j][k] : -param->alpha2 * s2[j] * a1[k];
+								weight2[j][k] = weight2[j][k] + deltaWeight2[j][k];
+								if (weight2[j][k] > param->maxWeight) {
+									deltaWeight2[j][k] -= weight2[j][k] - param->maxWeight;
+									weight2[j][k] = param->maxWeight;
+								} else if (weight2[j][k] < param->minWeight) {
+									deltaWeight2[j][k] += param->minWeight - weight2[j][k];
+									weight2[j][k] = param->minWeight;
 								}
-							}
-						} 
-					}
-					/* Calculate the average number of write pulses on the selected row */
-					#pragma omp critical    // Use critical here since NeuroSim class functions may update its member variables
-					{
-						if (AnalogNVM *temp = dynamic_cast<AnalogNVM*>(arrayHO->cell[0][0])) {  // Analog eNVM
-							int sumNumWritePulse = 0;
-							for (int j = 0; j < param->nOutput; j++) {
-								sumNumWritePulse += abs(static_cast<AnalogNVM*>(arrayHO->cell[j][k])->numPulse);    // Note that LTD has negative pulse number
-							}
-							subArrayHO->numWritePulse = sumNumWritePulse / param->nOutput;
-							double writeVoltageSquareSumRow = 0;
-							if (param->writeEnergyReport) {
-								if (static_cast<AnalogNVM*>(arrayHO->cell[0][0])->nonIdenticalPulse) { // Non-identical write pulse scheme
-									for (int j = 0; j < param->nOutput; j++) {
-										writeVoltageSquareSumRow += static_cast<AnalogNVM*>(arrayHO->cell[j][k])->writeVoltageSquareSum;
-									}
-									if (sumNumWritePulse > 0) {	// Prevent division by 0
-										subArrayHO->cell.writeVoltage = sqrt(writeVoltageSquareSumRow / sumNumWritePulse);  // RMS value of write voltage in a row
-									} else {
-										subArrayHO->cell.writeVoltage = 0;
-									}
+								if (param->useHardwareInTrainingFF) {
+									arrayHO->WriteCell(j, k, deltaWeight2[j][k], weight2[j][k], param->maxWeight, param->minWeight, false);
 								}
-                                else if(HybridCell *temp = dynamic_cast<HybridCell*>(arrayHO->cell[0][0]))
-                                {
-							         int sumNumWritePulse = 0;
-							         for (int j = 0; j < param->nHide; j++) {
-								           sumNumWritePulse += abs(static_cast<HybridCell*>(arrayHO->cell[j][k])->LSBcell.numPulse);    // Note that LTD has negative pulse number
-							          }
-                                     subArrayHO->numWritePulse = sumNumWritePulse / param->nHide;
-                                }
 							}
 						}
-						numWriteCellPerOperation = (double)numWriteCellPerOperation/numWriteOperationPerRow;
-						sumNeuroSimWriteEnergy += NeuroSimSubArrayWriteEnergy(subArrayHO, numWriteOperationPerRow, numWriteCellPerOperation);
-					}
-					numWriteOperation += numWriteOperationPerRow;
-				}
-				arrayHO->writeEnergy += sumArrayWriteEnergy;
-				subArrayHO->writeDynamicEnergy += sumNeuroSimWriteEnergy;
-				numWriteOperation = numWriteOperation / param->nHide;
-				subArrayHO->writeLatency += NeuroSimSubArrayWriteLatency(subArrayHO, numWriteOperation, sumWriteLatencyAnalogNVM);
-
-				#pragma omp parallel for
-					for (int n = 0; n < param->nHide; n++) {
-						delete[] pulse[n];
-					}
-					delete[] pulse;
-			} else {
-				#pragma omp parallel for
-				for (int j = 0; j < param->nOutput; j++) {
-					for (int k = 0; k < param->nHide; k++) {
-						deltaWeight2[j][k] = -param->alpha2 * s2[j] * a1[k];
-						weight2[j][k] = weight2[j][k] + deltaWeight2[j][k];
-						if (weight2[j][k] > param->maxWeight) {
-							deltaWeight2[j][k] -= weight2[j][k] - param->maxWeight;
-							weight2[j][k] = param->maxWeight;
-						} else if (weight2[j][k] < param->minWeight) {
-							deltaWeight2[j][k] += param->minWeight - weight2[j][k];
-							weight2[j][k] = param->minWeight;
-						}
-						if (param->useHardwareInTrainingFF) {
-							arrayHO->WriteCell(j, k, deltaWeight2[j][k], weight2[j][k], param->maxWeight, param->minWeight, false);
-						}
+						workspaceHO.Reset();
 					}
 				}
 			}
+			if (concurrentWU) {
+				omp_set_max_active_levels(maxActiveLevels);
+			}
+			/* The tracking totals are shared by the two layers, so they are added after both WUs in layer order */
+			totalWeightUpdate += layerWriteIH.weightUpdate;
+			totalWeightUpdate += layerWriteHO.weightUpdate;
+			totalNumPulse += layerWriteIH.numPulse;
+			totalNumPulse += layerWriteHO.numPulse;
 		}
+		randomPhase.epoch++;
     }
-}
-
-double SGD(double gradient, double learning_rate){
-    return -learning_rate * gradient; 
-}
-
-double Momentum(double gradient, double learning_rate, double momentumPrev, double GAMA){
-    double momentumNow; 
-    momentumNow = GAMA*momentumPrev + (1-GAMA)*gradient;
-    return -learning_rate*momentumNow;
-}
-
-double Adagrad(double gradient, double learning_rate, double gradSquare, double EPSILON){
-    return -learning_rate/(sqrt(gradSquare)+EPSILON)*gradient;
-}
-
-double RMSprop(double gradient, double learning_rate, double gradSquarePrev,double GAMA, double EPSILON){
-    double gradSquareNow;
-    gradSquareNow = GAMA*gradSquarePrev+(1-GAMA)*pow(gradient,2);
-    return -learning_rate/(sqrt(gradSquareNow)+EPSILON)*gradient;
-}
-
-double Adam(double gradient, double learning_rate, double momentumPrev, double velocityPrev, double epoch,double BETA1, double BETA2, double EPSILON){
-    double mt = BETA1*momentumPrev+(1-BETA1)*gradient;
-    double vt = BETA2*velocityPrev+(1-BETA2)*pow(gradient,2);
-    // correct the bias
-    mt = mt/(1-pow(BETA1,epoch));
-    vt = vt/(1-pow(BETA2,epoch));
-    return -learning_rate*mt/(sqrt(vt)+EPSILON);
+	trainTimePerSample = (omp_get_wtime() - startTime) / ((double)numTrain * epochs);
 }
 
 void WeightTransfer_2T1F(void)
@@ -1055,6 +1351,7 @@ void WeightTransfer_2T1F(void)
             int rowLTD=0;
             for (int j=0; j<param->nHide; j++) {
                 static_cast<_2T1F*>(arrayIH->cell[j][i])->WeightTransfer( );
+                arrayIH->SyncCell(j, i);
                 arrayIH->transferEnergy += static_cast<_2T1F*>(arrayIH->cell[j][i])->transEnergy;
                 if(static_cast<_2T1F*>(arrayIH->cell[j][i])->transLTP)
                     rowLTP=1;
@@ -1068,6 +1365,7 @@ void WeightTransfer_2T1F(void)
             int rowLTD=0;
             for (int j=0; j<param->nOutput; j++) {
                 static_cast<_2T1F*>(arrayHO->cell[j][i])->WeightTransfer( );
+                arrayHO->SyncCell(j, i);
                 arrayHO->transferEnergy += static_cast<_2T1F*>(arrayHO->cell[j][i])->transEnergy;
                 if(static_cast<_2T1F*>(arrayHO->cell[j][i])->transLTP)
                     rowLTP=1;
@@ -1080,6 +1378,7 @@ void WeightTransfer_2T1F(void)
 
 void WeightTransfer(void) // WeightTransfer for the Hybridcell
 {
+    randomPhase.step = RANDOM_STEP_READBACK;	// Every read of a cell before and after the transfer draws its own read noise
     for(int i=0; i<param->nInput;i++){
         for (int j=0; j<param->nHide; j++) {
             // transfer the weight from MSB to LSB
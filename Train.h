@@ -41,16 +41,16 @@
 #define TRAIN_H_
 extern double totalWeightUpdate; // track the total weight update (absolute value) during the whole training process
 extern double totalNumPulse;// track the total number of pulse for the weight update process; for Analog device only
-// void Train(const int numTrain, const int epochs);
-void Train(const int numTrain, const int epochs, char* optimization_type); // For decayed learning rate
+void Train(const int numTrain, const int epochs); // The optimizer of each layer is chosen by param->optimization_type
 void WeightTransfer(void); // For decayed learning rate
 void WeightTransfer_2T1F(void);
 /* Availiable optimization type includes
 "SGD": the stochastic gradient descent
 "Momentum": the momentum optimization
-"Adagrad": 
-"RMSprop": 
-"Adam": 
+"Adagrad": the adaptive gradient optimization
+"RMSprop": the root mean square propagation
+"Adam": the adaptive moment estimation
+(see Optimizer.h)
  */
 #endif
 
@@ -0,0 +1,100 @@
+/*******************************************************************************
+* Copyright (c) 2015-2017
+* School of Electrical, Computer and Energy Engineering, Arizona State University
+* PI: Prof. Shimeng Yu
+* All rights reserved.
+*   
+* This source code is part of NeuroSim - a device-circuit-algorithm framework to benchmark 
+* neuro-inspired architectures with synaptic devices(e.g., SRAM and emerging non-volatile memory). 
+* Copyright of the model is maintained by the developers, and the model is distributed under 
+* the terms of the Creative Commons Attribution-NonCommercial 4.0 International Public License 
+* http://creativecommons.org/licenses/by-nc/4.0/legalcode.
+* The source code is free and you can redistribute and/or modify it
+* by providing that the following conditions are met:
+*   
+*  1) Redistributions of source code must retain the above copyright notice,
+*     this list of conditions and the following disclaimer. 
+*   
+*  2) Redistributions in binary form must reproduce the above copyright notice,
+*     this list of conditions and the following disclaimer in the documentation
+*     and/or other materials provided with the distribution.
+*   
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+* Developer list: 
+*   Pai-Yu Chen     Email: pchen72 at asu dot edu 
+*                     
+*   Xiaochen Peng   Email: xpeng15 at asu dot edu
+********************************************************************************/
+
+#ifndef WORKSPACE_H_
+#define WORKSPACE_H_
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/* Scratch memory arena: one 64-byte aligned block sized once, handed out by bumping an offset.
+   Reset() to a Mark() releases everything allocated after the mark, so the per-sample buffers reuse the same memory
+   and a training sample does not call the heap allocator at all. The buffers are not initialized. */
+class Workspace {
+public:
+	static const size_t alignment = 64;
+
+	Workspace(size_t capacity): capacity(capacity), used(0) {
+		if (posix_memalign((void **)&block, alignment, capacity ? capacity : alignment)) {
+			puts("[Error] Cannot allocate the workspace");
+			exit(-1);
+		}
+	}
+	~Workspace() { free(block); }
+
+	/* # of bytes that Allocate<T>(n) / AllocateMatrix<T>(rows, cols) take (to size the workspace) */
+	template <class T> static size_t Bytes(size_t n) {
+		return (n * sizeof(T) + alignment - 1) / alignment * alignment;
+	}
+	template <class T> static size_t MatrixBytes(size_t rows, size_t cols) {
+		return Bytes<T*>(rows) + Bytes<T>(rows * cols);
+	}
+
+	template <class T> T *Allocate(size_t n) {
+		size_t bytes = Bytes<T>(n);
+		if (used + bytes > capacity) {
+			printf("[Error] Workspace overflow (%lu of %lu bytes)\n", (unsigned long)(used + bytes), (unsigned long)capacity);
+			exit(-1);
+		}
+		T *p = (T *)(block + used);
+		used += bytes;
+		return p;
+	}
+	/* rows x cols matrix in one contiguous row-major buffer, accessed as m[row][col] */
+	template <class T> T **AllocateMatrix(size_t rows, size_t cols) {
+		T **m = Allocate<T*>(rows);
+		T *data = Allocate<T>(rows * cols);
+		for (size_t r = 0; r < rows; r++) {
+			m[r] = data + r * cols;
+		}
+		return m;
+	}
+
+	size_t Mark() const { return used; }
+	void Reset(size_t mark = 0) { used = mark; }
+
+private:
+	char *block;
+	size_t capacity;	// Size of block (bytes)
+	size_t used;		// Bytes handed out
+	Workspace(const Workspace &);
+	Workspace &operator=(const Workspace &);
+};
+
+#endif
@@ -39,8 +39,10 @@
 #include <cstdio>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 #include <sstream>
 #include <string>
+#include <cstring>
 #include <stdlib.h>
 #include <random>
 #include <vector>
@@ -53,17 +55,50 @@
 #include "Train.h"
 #include "Test.h"
 #include "Mapping.h"
+#include "Dataset.h"
+#include "Optimizer.h"
+#include "Replica.h"
+#include "NetworkShape.h"
 #include "Definition.h"
 #include "omp.h"
  
 using namespace std;
 
 int main() {
-	gen.seed(0);
+	if (replicas->IsActive() && param->hogwildTraining) {
+		printf("[Error] The replicas average synchronous updates, they cannot be used with the Hogwild training\n");
+		exit(-1);
+	}
+	if (param->hogwildTraining && !param->useHardwareInTraining && (strcmp(param->optimization_type, "SGD") != 0 || param->numTrainImagesPerBatch != 1)) {
+		printf("[Error] The Hogwild training updates the weights with plain SGD after every sample (optimization_type = \"SGD\" and numTrainImagesPerBatch = 1)\n");
+		exit(-1);
+	}
+	if (!TrainNetworkShape::Matches(param)) {
+		printf("[Error] The network shape of Param.cpp (%d-%d-%d) is not the one this build was fixed to (NETWORK_SHAPE in makefile)\n", param->nInput, param->nHide, param->nOutput);
+		exit(-1);
+	}
+	replicas->Start();	// Fork the training replicas before any OpenMP region
+	randomPhase.seed = replicas->replica;	// Each replica has its own device variation and random streams
 	
-	/* Load in MNIST data */
-	ReadTrainingDataFromFile("patch60000_train.txt", "label60000_train.txt");
-	ReadTestingDataFromFile("patch10000_test.txt", "label10000_test.txt");
+	/* Load in MNIST data (the text files are converted once to binary files, which are memory-mapped afterwards) */
+	if (replicas->replica == 0) {
+		if (!ReadTrainingDataFromBinary("mnist60000_train.bin", "patch60000_train.txt", "label60000_train.txt")) {
+			ReadTrainingDataFromFile("patch60000_train.txt", "label60000_train.txt");
+			WriteTrainingDataToBinary("mnist60000_train.bin", "patch60000_train.txt", "label60000_train.txt");
+		}
+		if (!ReadTestingDataFromBinary("mnist10000_test.bin", "patch10000_test.txt", "label10000_test.txt")) {
+			ReadTestingDataFromFile("patch10000_test.txt", "label10000_test.txt");
+			WriteTestingDataToBinary("mnist10000_test.bin", "patch10000_test.txt", "label10000_test.txt");
+		}
+	}
+	replicas->Barrier();	// The other replicas map the binary files once replica 0 has written them
+	if (replicas->replica != 0) {
+		if (!ReadTrainingDataFromBinary("mnist60000_train.bin", "patch60000_train.txt", "label60000_train.txt")
+				|| !ReadTestingDataFromBinary("mnist10000_test.bin", "patch10000_test.txt", "label10000_test.txt")) {
+			printf("[Error] Replica %d cannot read the binary MNIST files\n", replicas->replica);
+			exit(-1);
+		}
+	}
 
 
 
@@ -86,7 +121,9 @@ int main() {
 	//arrayHO->Initialization<HybridCell>(); // the 3T1C+2PCM cell
 	//arrayHO->Initialization<_2T1F>();
 
-    omp_set_num_threads(16);
+    if (!getenv("OMP_NUM_THREADS")) {	// Set by make bench
+        omp_set_num_threads(16);
+    }
 	/* Initialization of NeuroSim synaptic cores */
 	param->relaxArrayCellWidth = 0;
 	NeuroSimSubArrayInitialize(subArrayIH, arrayIH, inputParameterIH, techIH, cellIH);
@@ -135,14 +172,25 @@ int main() {
 	srand(0);	// Pseudorandom number seed
 	
 	ofstream mywriteoutfile;
-	mywriteoutfile.open("output.csv");                                                                                                            
+	if (replicas->replica == 0) {
+		mywriteoutfile.open("output.csv");
+	}
+	double trainingLossPrev = 0;	// Convergence check of the asynchronous training
 	for (int i=1; i<=param->totalNumEpochs/param->interNumEpochs; i++){
-		Train(param->numTrainImagesPerEpoch, param->interNumEpochs,param->optimization_type);
+		Train(param->numTrainImagesPerEpoch / replicas->numReplicas, param->interNumEpochs);	// The replicas share the samples of an epoch
+		if (param->hogwildTraining && !param->useHardwareInTraining) {	// The lock-free updates may diverge with too many threads or a too high learning rate
+			double trainingLoss = TrainingLoss(std::min(param->numTrainImagesPerEpoch, param->numMnistTrainImages));
+			printf("Training loss at %d epochs is : %.4e\n", i*param->interNumEpochs, trainingLoss);
+			if (i > 1 && trainingLoss > trainingLossPrev) {
+				printf("\tWarning: the training loss increased, the asynchronous training may not converge (use fewer threads or a lower learning rate)\n");
+			}
+			trainingLossPrev = trainingLoss;
+		}
 		if (!param->useHardwareInTraining && param->useHardwareInTestingFF) { WeightToConductance(); }
 		Validate();
-        if (HybridCell *temp = dynamic_cast<HybridCell*>(arrayIH->cell[0][0]))
+        if (arrayIH->IsHybridCell())
             WeightTransfer();
-        else if(_2T1F *temp = dynamic_cast<_2T1F*>(arrayIH->cell[0][0]))
+        else if(arrayIH->Is2T1F())
             WeightTransfer_2T1F();
                 
 		mywriteoutfile << i*param->interNumEpochs << ", " << (double)correct/param->numMnistTestImages*100 << endl;
@@ -153,12 +201,13 @@ int main() {
 		printf("\tWrite latency=%.4e s\n", subArrayIH->writeLatency + subArrayHO->writeLatency);
 		printf("\tRead energy=%.4e J\n", arrayIH->readEnergy + subArrayIH->readDynamicEnergy + arrayHO->readEnergy + subArrayHO->readDynamicEnergy);
 		printf("\tWrite energy=%.4e J\n", arrayIH->writeEnergy + subArrayIH->writeDynamicEnergy + arrayHO->writeEnergy + subArrayHO->writeDynamicEnergy);
-		if(HybridCell* temp = dynamic_cast<HybridCell*>(arrayIH->cell[0][0])){
+		printf("\tTraining wall time per sample=%.4e s\n", trainTimePerSample);
+		if(arrayIH->IsHybridCell()){
             printf("\tTransfer latency=%.4e s\n", subArrayIH->transferLatency + subArrayHO->transferLatency);
             printf("\tTransfer latency=%.4e s\n", subArrayIH->transferLatency);	
             printf("\tTransfer energy=%.4e J\n", arrayIH->transferEnergy + subArrayIH->transferDynamicEnergy + arrayHO->transferEnergy + subArrayHO->transferDynamicEnergy);
         }
-        else if(_2T1F* temp = dynamic_cast<_2T1F*>(arrayIH->cell[0][0])){
+        else if(arrayIH->Is2T1F()){
             printf("\tTransfer latency=%.4e s\n", subArrayIH->transferLatency);	
             printf("\tTransfer energy=%.4e J\n", arrayIH->transferEnergy + subArrayIH->transferDynamicEnergy + arrayHO->transferEnergy + subArrayHO->transferDynamicEnergy);
          }
@@ -167,6 +216,7 @@ int main() {
 	}
 	// print the summary: 
 	printf("\n");
+	replicas->Stop();
 	return 0;
 }
 